@@ -0,0 +1,372 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmAVEncoder.cpp
+*
+*/
+
+#include <time.h>
+
+#include "pmAVEncoder.hpp"
+
+// FFmpeg 5.1 replaced channels/channel_layout with AVChannelLayout
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 24, 100)
+#define PM_AV_CH_LAYOUT 1
+#endif
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static std::string averr(int rc) {
+    char buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(rc, buf, sizeof(buf));
+    return buf;
+}
+
+pmAVEncoder::pmAVEncoder() {
+    oc = NULL;
+    vc = ac = NULL;
+    vst = ast = NULL;
+    vframe = srcframe = aframe = NULL;
+    pkt = NULL;
+    sws = NULL;
+    fifo = NULL;
+    srcpixfmt = AV_PIX_FMT_NONE;
+    width = height = channels = 0;
+    vpts = apts = 0;
+    opened = false;
+    frames = encns = maxencns = 0;
+}
+
+pmAVEncoder::~pmAVEncoder() {
+    close();
+}
+
+bool pmAVEncoder::open(const std::string &path, const std::string &vcodec, int threads,
+                       int _width, int _height, int fps, const std::string &srcfmt,
+                       int samplerate, int _channels, std::string &err) {
+    width = _width;
+    height = _height;
+    channels = _channels;
+    srcpixfmt = av_get_pix_fmt(srcfmt.c_str());
+
+    int rc = avformat_alloc_output_context2(&oc, NULL, NULL, path.c_str());
+    if (rc < 0) {
+        err = "cannot guess output format for " + path + ": " + averr(rc);
+        return false;
+    }
+
+    // Video
+    const AVCodec *codec = avcodec_find_encoder_by_name(vcodec.c_str());
+    if (codec == NULL) {
+        err = "unknown video encoder " + vcodec;
+        return false;
+    }
+    vst = avformat_new_stream(oc, NULL);
+    vc = avcodec_alloc_context3(codec);
+    vc->width = width;
+    vc->height = height;
+    vc->time_base = av_make_q(1, fps);
+    vc->framerate = av_make_q(fps, 1);
+    vc->thread_count = threads;
+    vc->pix_fmt = AV_PIX_FMT_YUV420P;
+    if (codec->pix_fmts != NULL) {
+        const enum AVPixelFormat *pf = codec->pix_fmts;
+        while (*pf != AV_PIX_FMT_NONE && *pf != AV_PIX_FMT_YUV420P) pf++;
+        if (*pf == AV_PIX_FMT_NONE) vc->pix_fmt = codec->pix_fmts[0];
+    }
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER) {
+        vc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if ((rc = avcodec_open2(vc, codec, NULL)) < 0) {
+        err = "cannot open video encoder " + vcodec + ": " + averr(rc);
+        return false;
+    }
+    avcodec_parameters_from_context(vst->codecpar, vc);
+    vst->time_base = vc->time_base;
+
+    vframe = av_frame_alloc();
+    vframe->format = vc->pix_fmt;
+    vframe->width = width;
+    vframe->height = height;
+    if ((rc = av_frame_get_buffer(vframe, 0)) < 0) {
+        err = "cannot allocate video frame: " + averr(rc);
+        return false;
+    }
+    // Frames already in the encoder's format skip swscale entirely and
+    // are wrapped around the mapped buffer as they are.
+    srcframe = av_frame_alloc();
+    if (srcpixfmt != vc->pix_fmt) {
+        sws = sws_getContext(width, height, srcpixfmt, width, height, vc->pix_fmt,
+                             SWS_POINT, NULL, NULL, NULL);
+        if (sws == NULL) {
+            err = "cannot convert " + srcfmt + " for the video encoder";
+            return false;
+        }
+    }
+
+    // Audio: PCM comes from the render loop, so it lines up with the
+    // frames by construction.
+    if (samplerate > 0) {
+        const AVCodec *acodec = avcodec_find_encoder_by_name("aac");
+        if (acodec == NULL) {
+            err = "no aac encoder";
+            return false;
+        }
+        ast = avformat_new_stream(oc, NULL);
+        ac = avcodec_alloc_context3(acodec);
+        ac->sample_fmt = acodec->sample_fmts ? acodec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+        if (ac->sample_fmt != AV_SAMPLE_FMT_FLTP && ac->sample_fmt != AV_SAMPLE_FMT_S16) {
+            err = "unsupported sample format of the aac encoder";
+            return false;
+        }
+        ac->sample_rate = samplerate;
+        ac->bit_rate = 192000;
+        ac->time_base = av_make_q(1, samplerate);
+#ifdef PM_AV_CH_LAYOUT
+        av_channel_layout_default(&ac->ch_layout, channels);
+#else
+        ac->channels = channels;
+        ac->channel_layout = av_get_default_channel_layout(channels);
+#endif
+        if (oc->oformat->flags & AVFMT_GLOBALHEADER) {
+            ac->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        if ((rc = avcodec_open2(ac, acodec, NULL)) < 0) {
+            err = "cannot open audio encoder: " + averr(rc);
+            return false;
+        }
+        avcodec_parameters_from_context(ast->codecpar, ac);
+        ast->time_base = ac->time_base;
+
+        int fsz = ac->frame_size > 0 ? ac->frame_size : 1024;
+        fifo = av_audio_fifo_alloc(ac->sample_fmt, channels, fsz * 4);
+        aframe = av_frame_alloc();
+        aframe->format = ac->sample_fmt;
+        aframe->nb_samples = fsz;
+        aframe->sample_rate = samplerate;
+#ifdef PM_AV_CH_LAYOUT
+        av_channel_layout_copy(&aframe->ch_layout, &ac->ch_layout);
+#else
+        aframe->channels = channels;
+        aframe->channel_layout = ac->channel_layout;
+#endif
+        if ((rc = av_frame_get_buffer(aframe, 0)) < 0) {
+            err = "cannot allocate audio frame: " + averr(rc);
+            return false;
+        }
+        planes.resize(channels);
+    }
+
+    if (!(oc->oformat->flags & AVFMT_NOFILE)) {
+        if ((rc = avio_open(&oc->pb, path.c_str(), AVIO_FLAG_WRITE)) < 0) {
+            err = "cannot open " + path + ": " + averr(rc);
+            return false;
+        }
+    }
+    if ((rc = avformat_write_header(oc, NULL)) < 0) {
+        err = "cannot write header: " + averr(rc);
+        return false;
+    }
+    pkt = av_packet_alloc();
+    opened = true;
+    return true;
+}
+
+bool pmAVEncoder::encode(AVCodecContext *c, AVStream *st, AVFrame *f) {
+    int rc = avcodec_send_frame(c, f);
+    if (rc < 0) {
+        std::cerr << "encoder error: " << averr(rc) << std::endl;
+        return false;
+    }
+    for (;;) {
+        rc = avcodec_receive_packet(c, pkt);
+        if (rc == AVERROR(EAGAIN) || rc == AVERROR_EOF) break;
+        if (rc < 0) {
+            std::cerr << "encoder error: " << averr(rc) << std::endl;
+            return false;
+        }
+        av_packet_rescale_ts(pkt, c->time_base, st->time_base);
+        pkt->stream_index = st->index;
+        rc = av_interleaved_write_frame(oc, pkt);
+        if (rc < 0) {
+            std::cerr << "muxer error: " << averr(rc) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool pmAVEncoder::addVideo(const unsigned char *data) {
+    unsigned long long t0 = nowns();
+
+    uint8_t *src[4] = { (uint8_t *)data, NULL, NULL, NULL };
+    int stride[4] = { width, 0, 0, 0 };
+    switch (srcpixfmt) {
+    case AV_PIX_FMT_BGRA:
+        stride[0] = width * 4;
+        break;
+    case AV_PIX_FMT_NV12:
+        src[1] = src[0] + width * height;
+        stride[1] = width;
+        break;
+    default: // yuv420p
+        src[1] = src[0] + width * height;
+        src[2] = src[1] + width * height / 4;
+        stride[1] = stride[2] = width / 2;
+        break;
+    }
+
+    AVFrame *f;
+    if (sws != NULL) {
+        av_frame_make_writable(vframe);
+        sws_scale(sws, src, stride, 0, height, vframe->data, vframe->linesize);
+        f = vframe;
+    } else {
+        // not refcounted: avcodec_send_frame takes its own copy
+        for (int i = 0; i < 4; i++) {
+            srcframe->data[i] = src[i];
+            srcframe->linesize[i] = stride[i];
+        }
+        srcframe->format = srcpixfmt;
+        srcframe->width = width;
+        srcframe->height = height;
+        f = srcframe;
+    }
+    f->pts = vpts++;
+    bool ok = encode(vc, vst, f);
+
+    unsigned long long dt = nowns() - t0;
+    frames++;
+    encns += dt;
+    if (dt > maxencns) maxencns = dt;
+    return ok;
+}
+
+bool pmAVEncoder::drainFifo(bool flush) {
+    while (av_audio_fifo_size(fifo) >= aframe->nb_samples ||
+           (flush && av_audio_fifo_size(fifo) > 0)) {
+        av_frame_make_writable(aframe);
+        int n = av_audio_fifo_read(fifo, (void **)aframe->data, aframe->nb_samples);
+        if (n < aframe->nb_samples) {
+            // short last frame: pad with silence rather than resize
+            av_samples_set_silence(aframe->data, n, aframe->nb_samples - n, channels, ac->sample_fmt);
+        }
+        aframe->pts = apts;
+        apts += aframe->nb_samples;
+        if (!encode(ac, ast, aframe)) return false;
+    }
+    return true;
+}
+
+bool pmAVEncoder::addAudio(const short *pcm, int nframes) {
+    if (ac == NULL || nframes <= 0) return true;
+    if (ac->sample_fmt == AV_SAMPLE_FMT_S16) {
+        void *p = (void *)pcm;
+        av_audio_fifo_write(fifo, &p, nframes);
+    } else {
+        void *pp[AV_NUM_DATA_POINTERS];
+        for (int c = 0; c < channels; c++) {
+            std::vector<float> &pl = planes[c];
+            if ((int)pl.size() < nframes) pl.resize(nframes);
+            for (int i = 0; i < nframes; i++) {
+                pl[i] = pcm[i * channels + c] / 32768.0f;
+            }
+            pp[c] = pl.data();
+        }
+        av_audio_fifo_write(fifo, pp, nframes);
+    }
+    return drainFifo(false);
+}
+
+bool pmAVEncoder::addAudio(const float *pcm, int nframes) {
+    if (ac == NULL || nframes <= 0) return true;
+    if (ac->sample_fmt == AV_SAMPLE_FMT_S16) {
+        std::vector<short> s16(nframes * channels);
+        for (int i = 0; i < nframes * channels; i++) {
+            float v = pcm[i] * 32768.0f;
+            s16[i] = v > 32767.0f ? 32767 : v < -32768.0f ? -32768 : (short)v;
+        }
+        void *p = s16.data();
+        av_audio_fifo_write(fifo, &p, nframes);
+    } else {
+        void *pp[AV_NUM_DATA_POINTERS];
+        for (int c = 0; c < channels; c++) {
+            std::vector<float> &pl = planes[c];
+            if ((int)pl.size() < nframes) pl.resize(nframes);
+            for (int i = 0; i < nframes; i++) {
+                pl[i] = pcm[i * channels + c];
+            }
+            pp[c] = pl.data();
+        }
+        av_audio_fifo_write(fifo, pp, nframes);
+    }
+    return drainFifo(false);
+}
+
+bool pmAVEncoder::close() {
+    bool ok = true;
+    if (opened) {
+        if (ac != NULL) {
+            ok = drainFifo(true) && ok;
+            ok = encode(ac, ast, NULL) && ok;
+        }
+        ok = encode(vc, vst, NULL) && ok;
+        int rc = av_write_trailer(oc);
+        if (rc < 0) {
+            std::cerr << "muxer error: " << averr(rc) << std::endl;
+            ok = false;
+        }
+        opened = false;
+    }
+    if (oc != NULL && !(oc->oformat->flags & AVFMT_NOFILE)) {
+        int rc = avio_closep(&oc->pb);
+        if (rc < 0) {
+            std::cerr << "cannot close output: " << averr(rc) << std::endl;
+            ok = false;
+        }
+    }
+    avcodec_free_context(&vc);
+    avcodec_free_context(&ac);
+    av_frame_free(&vframe);
+    av_frame_free(&srcframe);
+    av_frame_free(&aframe);
+    av_packet_free(&pkt);
+    if (fifo != NULL) {
+        av_audio_fifo_free(fifo);
+        fifo = NULL;
+    }
+    sws_freeContext(sws);
+    sws = NULL;
+    avformat_free_context(oc);
+    oc = NULL;
+    return ok;
+}
+
+void pmAVEncoder::report(std::ostream &os) const {
+    os << "In-process encoder: " << frames << " frames, encode latency mean "
+       << (frames ? encns / frames / 1000000.0 : 0) << " ms, max "
+       << maxencns / 1000000.0 << " ms" << std::endl;
+}
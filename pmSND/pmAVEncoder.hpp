@@ -0,0 +1,89 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmAVEncoder.hpp
+* In-process encoder and muxer on top of libavcodec/libavformat, used
+* instead of piping raw frames into an ffmpeg child (-e lavc).
+*
+*/
+
+
+#ifndef pmAVEncoder_hpp
+#define pmAVEncoder_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libswscale/swscale.h>
+}
+
+class pmAVEncoder {
+public:
+    pmAVEncoder();
+    ~pmAVEncoder();
+
+    // srcfmt is the layout of the frames handed to addVideo(): "bgra",
+    // "yuv420p" or "nv12", as produced by the readback path. threads = 0
+    // lets the codec decide. samplerate = 0 means no audio stream.
+    bool open(const std::string &path, const std::string &vcodec, int threads,
+              int width, int height, int fps, const std::string &srcfmt,
+              int samplerate, int channels, std::string &err);
+
+    // Encode one frame straight from the mapped readback buffer.
+    bool addVideo(const unsigned char *data);
+    // Interleaved 16 bit PCM; nframes sample frames.
+    bool addAudio(const short *pcm, int nframes);
+    // Interleaved float PCM in [-1, 1], as read with -F.
+    bool addAudio(const float *pcm, int nframes);
+
+    // Flush both encoders and finalize the file. False if any of that
+    // failed, leaving the file truncated or without its trailer.
+    bool close();
+
+    void report(std::ostream &os) const;
+
+private:
+    AVFormatContext *oc;
+    AVCodecContext *vc, *ac;
+    AVStream *vst, *ast;
+    AVFrame *vframe, *srcframe, *aframe;
+    AVPacket *pkt;
+    SwsContext *sws;
+    AVAudioFifo *fifo;
+    AVPixelFormat srcpixfmt;
+    int width, height, channels;
+    int64_t vpts, apts;
+    std::vector<std::vector<float> > planes;
+    bool opened;
+
+    unsigned long long frames, encns, maxencns;
+
+    bool encode(AVCodecContext *c, AVStream *st, AVFrame *f);
+    bool drainFifo(bool flush);
+};
+
+#endif /* pmAVEncoder_hpp */
@@ -0,0 +1,329 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmAudio.cpp
+*
+*/
+
+#include <chrono>
+#include <algorithm>
+#include <time.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pmAudio.hpp"
+#include "pmTrace.hpp"
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+pmAudioReader::pmAudioReader() : head(0), eof(false), quit(false) {
+    sndf = NULL;
+    map = NULL;
+    mapframe = 0;
+    cpuns = 0;
+    floatpcm = false;
+    channels = blockframes = smplsize = 0;
+    nblocks = 0;
+    readers = 1;
+    for (int r = 0; r < MAXREADERS; r++) {
+        tail[r] = 0;
+        blocks[r] = underruns[r] = underrunns[r] = 0;
+    }
+}
+
+pmAudioReader::~pmAudioReader() {
+    stop();
+}
+
+// Weights that fold each channel into left and right, from the file's
+// channel map if libsndfile knows it, else assuming the WAV order
+// FL FR FC LFE BL BR SL SR. Scaled so that neither side can clip.
+static void downmixWeights(SNDFILE *sndf, int channels, std::vector<float> &wl, std::vector<float> &wr) {
+    const float h = 0.7071f;
+    static const int wavorder[] = {
+        SF_CHANNEL_MAP_FRONT_LEFT, SF_CHANNEL_MAP_FRONT_RIGHT, SF_CHANNEL_MAP_FRONT_CENTER,
+        SF_CHANNEL_MAP_LFE, SF_CHANNEL_MAP_REAR_LEFT, SF_CHANNEL_MAP_REAR_RIGHT,
+        SF_CHANNEL_MAP_SIDE_LEFT, SF_CHANNEL_MAP_SIDE_RIGHT
+    };
+    std::vector<int> map(channels, SF_CHANNEL_MAP_INVALID);
+    if (sf_command(sndf, SFC_GET_CHANNEL_MAP_INFO, map.data(), channels * sizeof(int)) != SF_TRUE) {
+        for (int c = 0; c < channels; c++) {
+            map[c] = channels == 1 ? SF_CHANNEL_MAP_MONO : c < 8 ? wavorder[c] : SF_CHANNEL_MAP_INVALID;
+        }
+    }
+    int padded = (channels + 3) & ~3;
+    wl.assign(padded, 0.0f);
+    wr.assign(padded, 0.0f);
+    float suml = 0, sumr = 0;
+    for (int c = 0; c < channels; c++) {
+        switch (map[c]) {
+            case SF_CHANNEL_MAP_LEFT: case SF_CHANNEL_MAP_FRONT_LEFT:
+                wl[c] = 1.0f; break;
+            case SF_CHANNEL_MAP_RIGHT: case SF_CHANNEL_MAP_FRONT_RIGHT:
+                wr[c] = 1.0f; break;
+            case SF_CHANNEL_MAP_MONO:
+                wl[c] = wr[c] = 1.0f; break;
+            case SF_CHANNEL_MAP_CENTER: case SF_CHANNEL_MAP_FRONT_CENTER:
+                wl[c] = wr[c] = h; break;
+            case SF_CHANNEL_MAP_REAR_CENTER:
+                wl[c] = wr[c] = 0.5f; break;
+            case SF_CHANNEL_MAP_LFE:
+                break;
+            case SF_CHANNEL_MAP_REAR_LEFT: case SF_CHANNEL_MAP_SIDE_LEFT:
+            case SF_CHANNEL_MAP_FRONT_LEFT_OF_CENTER:
+                wl[c] = h; break;
+            case SF_CHANNEL_MAP_REAR_RIGHT: case SF_CHANNEL_MAP_SIDE_RIGHT:
+            case SF_CHANNEL_MAP_FRONT_RIGHT_OF_CENTER:
+                wr[c] = h; break;
+            default:
+                (c & 1 ? wr : wl)[c] = h; break;
+        }
+        suml += wl[c];
+        sumr += wr[c];
+    }
+    float norm = suml > sumr ? suml : sumr;
+    if (norm > 1.0f) {
+        for (int c = 0; c < channels; c++) {
+            wl[c] /= norm;
+            wr[c] /= norm;
+        }
+    }
+}
+
+void pmAudioReader::start(SNDFILE *_sndf, int _channels, int _blockframes, int _nblocks, bool _floatpcm, int _readers,
+                          pmPCMMap *_map) {
+    sndf = _sndf;
+    map = _floatpcm ? NULL : _map;
+    channels = _channels;
+    blockframes = _blockframes;
+    floatpcm = _floatpcm;
+    smplsize = floatpcm ? sizeof(float) : sizeof(short);
+    nblocks = _nblocks < 2 ? 2 : _nblocks;
+    readers = _readers < 1 ? 1 : _readers > MAXREADERS ? MAXREADERS : _readers;
+    // 16 spare bytes so the vector downmix may load a few floats past
+    // the last frame; they only ever meet zero weights. A mapped file
+    // needs no copy.
+    pcm.assign(map != NULL ? 0 : (size_t)nblocks * blockframes * channels * smplsize + 16, 0);
+    blockdata.assign(nblocks, NULL);
+    if (map != NULL) {
+        mapframe = sf_seek(sndf, 0, SEEK_CUR);
+        if (mapframe < 0) mapframe = 0;
+    }
+    cpuns = 0;
+    if (channels != 2) {
+        mix.assign((size_t)nblocks * blockframes * 2, 0.0f);
+        downmixWeights(sndf, channels, wl, wr);
+        tailframe.assign(wl.size(), 0);
+    }
+    lengths.assign(nblocks, 0);
+    head = 0;
+    for (int r = 0; r < MAXREADERS; r++) tail[r] = 0;
+    eof = quit = false;
+    decoder = std::thread(&pmAudioReader::run, this);
+}
+
+void pmAudioReader::stop() {
+    if (!decoder.joinable()) return;
+    quit = true;
+    decoder.join();
+}
+
+void pmAudioReader::downmix(unsigned int slot, int nframes) {
+    float *dst = &mix[(size_t)slot * blockframes * 2];
+    int padded = wl.size();
+    if (floatpcm) {
+        const float *src = (const float *)blockdata[slot];
+#ifdef __SSE__
+        // one frame per iteration: dot the frame with both weight vectors
+        // four channels at a time, then fold the two sums into L, R
+        for (int i = 0; i < nframes; i++, src += channels, dst += 2) {
+            __m128 l = _mm_setzero_ps(), r = _mm_setzero_ps();
+            for (int c = 0; c < padded; c += 4) {
+                __m128 x = _mm_loadu_ps(src + c);
+                l = _mm_add_ps(l, _mm_mul_ps(x, _mm_loadu_ps(&wl[c])));
+                r = _mm_add_ps(r, _mm_mul_ps(x, _mm_loadu_ps(&wr[c])));
+            }
+            __m128 t = _mm_add_ps(_mm_unpacklo_ps(l, r), _mm_unpackhi_ps(l, r));
+            t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+            _mm_storel_pi((__m64 *)dst, t);
+        }
+#else
+        for (int i = 0; i < nframes; i++, src += channels, dst += 2) {
+            float l = 0, r = 0;
+            for (int c = 0; c < channels; c++) {
+                l += src[c] * wl[c];
+                r += src[c] * wr[c];
+            }
+            dst[0] = l;
+            dst[1] = r;
+        }
+#endif
+    } else {
+        const short *src = (const short *)blockdata[slot];
+        const float scale = 1.0f / 16384.0f;
+#ifdef __SSE2__
+        // the float dot product above, on four samples at a time widened
+        // to float. A block may sit at the very end of a mapped file, so
+        // the last frames, whose loads would run past it, are copied out
+        // and padded first.
+        const __m128 vscale = _mm_set1_ps(scale);
+        for (int i = 0; i < nframes; i++, src += channels, dst += 2) {
+            const short *frame = src;
+            if ((nframes - i) * channels < padded) {
+                std::copy(src, src + channels, tailframe.begin());
+                frame = tailframe.data();
+            }
+            __m128 l = _mm_setzero_ps(), r = _mm_setzero_ps();
+            for (int c = 0; c < padded; c += 4) {
+                __m128i s16 = _mm_loadl_epi64((const __m128i *)(frame + c));
+                __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16));
+                l = _mm_add_ps(l, _mm_mul_ps(x, _mm_loadu_ps(&wl[c])));
+                r = _mm_add_ps(r, _mm_mul_ps(x, _mm_loadu_ps(&wr[c])));
+            }
+            __m128 t = _mm_add_ps(_mm_unpacklo_ps(l, r), _mm_unpackhi_ps(l, r));
+            t = _mm_mul_ps(_mm_add_ps(t, _mm_movehl_ps(t, t)), vscale);
+            _mm_storel_pi((__m64 *)dst, t);
+        }
+#else
+        for (int i = 0; i < nframes; i++, src += channels, dst += 2) {
+            float l = 0, r = 0;
+            for (int c = 0; c < channels; c++) {
+                l += src[c] * wl[c];
+                r += src[c] * wr[c];
+            }
+            dst[0] = l * scale;
+            dst[1] = r * scale;
+        }
+#endif
+    }
+}
+
+// Decode the next block into slot, or with a mapping point the slot at it and
+// touch its pages so they are read in here rather than by a reader.
+sf_count_t pmAudioReader::fill(unsigned int slot) {
+    if (map == NULL) {
+        unsigned char *dst = &pcm[(size_t)slot * blockframes * channels * smplsize];
+        blockdata[slot] = dst;
+        return floatpcm ? sf_readf_float(sndf, (float *)dst, blockframes)
+                        : sf_readf_short(sndf, (short *)dst, blockframes);
+    }
+    sf_count_t n = map->frames - mapframe;
+    if (n > blockframes) n = blockframes;
+    if (n <= 0) return 0;
+    const unsigned char *src = map->data + (size_t)mapframe * map->framesize;
+    size_t len = (size_t)n * map->framesize;
+    volatile unsigned char touch = 0;
+    for (size_t i = 0; i < len; i += 4096) touch += src[i];
+    touch += src[len - 1];
+    blockdata[slot] = src;
+    mapframe += n;
+    return n;
+}
+
+void pmAudioReader::run() {
+    pmTrace::nameThread("decoder");
+    while (!quit) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        unsigned int ahead = 0;
+        for (int r = 0; r < readers; r++) {
+            unsigned int d = h - tail[r].load(std::memory_order_acquire);
+            if (d > ahead) ahead = d;
+        }
+        // every reader is past the blocks before the slowest tail
+        sf_count_t done = mapframe - (sf_count_t)ahead * blockframes;
+        if (map != NULL && done > 0) map->release((size_t)done * map->framesize);
+        if (ahead == nblocks) {
+            // a whole ring ahead of the slowest reader: nothing to do for a while
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+        unsigned int slot = h % nblocks;
+        unsigned long long t0 = pmTrace::now();
+        sf_count_t n = fill(slot);
+        pmTrace::record(pmTrace::DECODE, t0, pmTrace::now());
+        if (n <= 0) {
+            eof.store(true, std::memory_order_release);
+            break;
+        }
+        lengths[slot] = n;
+        if (channels != 2) downmix(slot, n);
+        head.store(h + 1, std::memory_order_release);
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    cpuns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+const void *pmAudioReader::front(int &nframes, int reader) {
+    unsigned int t = tail[reader].load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t) {
+        // Decoder is behind (or done). Check eof before head again so
+        // a final block published just before eof is not lost.
+        unsigned long long t0 = nowns();
+        bool waited = false;
+        while (head.load(std::memory_order_acquire) == t) {
+            if (eof.load(std::memory_order_acquire)) {
+                if (head.load(std::memory_order_acquire) != t) break;
+                return NULL;
+            }
+            if (quit) return NULL;
+            waited = true;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        if (waited) {
+            underruns[reader]++;
+            underrunns[reader] += nowns() - t0;
+        }
+    }
+    unsigned int slot = t % nblocks;
+    nframes = lengths[slot];
+    return blockdata[slot];
+}
+
+const float *pmAudioReader::stereo(int reader) const {
+    if (channels == 2) return NULL;
+    unsigned int slot = tail[reader].load(std::memory_order_relaxed) % nblocks;
+    return &mix[(size_t)slot * blockframes * 2];
+}
+
+void pmAudioReader::pop(int reader) {
+    tail[reader].store(tail[reader].load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    blocks[reader]++;
+}
+
+void pmAudioReader::report(std::ostream &os) const {
+    os << "Audio prefetch: " << nblocks << " blocks of " << blockframes << " frames ("
+       << channels << " ch " << (floatpcm ? "float" : "s16") << (channels != 2 ? ", stereo mix" : "")
+       << (map != NULL ? ", mapped" : "") << "), decoder cpu " << cpuns / 1000000.0 << " ms" << std::endl;
+    for (int r = 0; r < readers; r++) {
+        os << "    " << (r == 0 ? "render" : "playback") << ": " << blocks[r] << " blocks consumed, decoder underruns "
+           << underruns[r] << " (" << underrunns[r] / 1000000.0 << " ms waited)" << std::endl;
+    }
+}
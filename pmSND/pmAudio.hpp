@@ -0,0 +1,114 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmAudio.hpp
+* Audio prefetch: a decoder thread reads the sound file ahead into a
+* lock-free single producer / single consumer ring of PCM blocks, one
+* block per video frame. The render loop takes each block once and uses
+* it for both projectM and playback.
+*
+* Blocks hold either 16 bit or float samples as decoded. Files that are
+* not stereo also get a float stereo mix per block, which is what projectM
+* is fed since its PCM entry points only take two interleaved channels.
+*
+* With live playback the ALSA thread is a second consumer with its own
+* cursor; a block is reused only once every reader has popped it.
+*
+* With a pmPCMMap the blocks are not copied at all: the ring only holds
+* pointers into the mapped file, and the thread just faults each block's
+* pages in ahead of the readers (and drops those every reader is done
+* with), so the render loop never waits on the disk.
+*
+*/
+
+
+#ifndef pmAudio_hpp
+#define pmAudio_hpp
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <sndfile.h>
+
+#include "pmPCMMap.hpp"
+
+class pmAudioReader {
+public:
+    pmAudioReader();
+    ~pmAudioReader();
+
+    enum { MAXREADERS = 2 };
+
+    // Decode blockframes sample frames per block, up to nblocks ahead,
+    // with sf_readf_float when floatpcm is set, sf_readf_short otherwise.
+    // readers is the number of independent consumers (1 or 2), reader 0
+    // being the render loop.
+    // With map, 16 bit blocks are taken from the mapping from the
+    // current position of sndf on, instead of being decoded.
+    void start(SNDFILE *sndf, int channels, int blockframes, int nblocks,
+               bool floatpcm = false, int readers = 1, pmPCMMap *map = NULL);
+    void stop();
+
+    // The next block (short or float interleaved samples) and its length
+    // in sample frames, or NULL at the end of the file or after stop().
+    // Waits if the decoder has fallen behind.
+    const void *front(int &nframes, int reader = 0);
+    // Stereo float mix of the block returned by front(), NULL if the file
+    // is stereo already. 16 bit input is scaled the way addPCM16Data does.
+    const float *stereo(int reader = 0) const;
+    // Give the block returned by front() back to the decoder.
+    void pop(int reader = 0);
+
+    bool floatpcm;
+
+    void report(std::ostream &os) const;
+
+private:
+    SNDFILE *sndf;
+    int channels, blockframes;
+    unsigned int nblocks;
+    int readers;
+    int smplsize;
+    std::vector<unsigned char> pcm; // nblocks * blockframes * channels samples
+    std::vector<float> mix;         // nblocks * blockframes * 2, if not stereo
+    std::vector<float> wl, wr;      // downmix weights, padded to 4 channels
+    std::vector<short> tailframe;   // a 16 bit frame near the end, zero padded
+    std::vector<int> lengths;       // frames in each block
+    std::vector<const unsigned char *> blockdata;  // into pcm, or the mapping
+    pmPCMMap *map;
+    sf_count_t mapframe;            // next frame to take from the mapping
+    unsigned long long cpuns;       // decoder thread CPU time
+
+    // head is only written by the decoder, each tail only by its reader
+    std::atomic<unsigned int> head, tail[MAXREADERS];
+    std::atomic<bool> eof, quit;
+    std::thread decoder;
+
+    unsigned long long blocks[MAXREADERS], underruns[MAXREADERS], underrunns[MAXREADERS];
+
+    void run();
+    sf_count_t fill(unsigned int slot);
+    void downmix(unsigned int slot, int nframes);
+};
+
+#endif /* pmAudio_hpp */
@@ -0,0 +1,79 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmBatch.cpp
+*
+*/
+
+#include <stdlib.h>
+#include <fstream>
+
+#include "pmBatch.hpp"
+
+bool readManifest(const std::string &path, std::vector<pmJob> &jobs, std::string &err) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        err = "cannot open job manifest " + path;
+        return false;
+    }
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); lineno++) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#') continue;
+
+        // split by hand: getline would drop an empty last field, which
+        // is how a job without output is written
+        std::vector<std::string> fields;
+        size_t start = 0, tab;
+        while ((tab = line.find('\t', start)) != std::string::npos) {
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        fields.push_back(line.substr(start));
+
+        std::string where = path + ":" + std::to_string(lineno) + ": ";
+        if (fields.size() < 3 || fields.size() > 5 || fields[0].empty()) {
+            err = where + "expected audiofile, preset, output[, before[, after]] separated by tabs";
+            return false;
+        }
+        pmJob job;
+        job.audioFile = fields[0];
+        job.presetName = fields[1];
+        job.videoName = fields[2];
+        job.before = job.after = 0;
+        long *pad[] = { &job.before, &job.after };
+        for (size_t i = 3; i < fields.size(); i++) {
+            char *endptr;
+            *pad[i - 3] = strtol(fields[i].c_str(), &endptr, 10);
+            if (endptr == fields[i].c_str() || *pad[i - 3] < 0) {
+                err = where + "cannot convert " + fields[i] + " to a number";
+                return false;
+            }
+        }
+        jobs.push_back(job);
+    }
+    if (jobs.empty()) {
+        err = "no jobs in " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmBatch.hpp
+* Batch mode (-B): a manifest of jobs rendered one after the other by the
+* same GL context and projectM instance.
+*
+* One job per line, fields separated by tabs (preset names have spaces):
+*
+*   audiofile <TAB> preset <TAB> output [<TAB> before [<TAB> after]]
+*
+* An empty preset field lets projectM pick presets as usual; a glob or
+* prefix matching several presets rotates among just those for that job.
+* An empty output plays or shows the track without exporting it. Blank lines and
+* lines starting with # are skipped.
+*
+*/
+
+
+#ifndef pmBatch_hpp
+#define pmBatch_hpp
+
+#include <string>
+#include <vector>
+
+struct pmJob {
+    std::string audioFile;
+    std::string presetName;
+    std::string videoName;
+    long before, after;
+};
+
+bool readManifest(const std::string &path, std::vector<pmJob> &jobs, std::string &err);
+
+#endif /* pmBatch_hpp */
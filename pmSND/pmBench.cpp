@@ -0,0 +1,329 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmBench.cpp
+*
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include "pmBench.hpp"
+#include "pmTrace.hpp"
+
+// fixed seed of the test signal's noise
+static const unsigned long long SYNTH_SEED = 0x9e3779b97f4a7c15ull;
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void pmSynthAudio(short *pcm, int nframes, int samplerate, unsigned long long &pos) {
+    for (int i = 0; i < nframes; i++, pos++) {
+        double t = (double)pos / samplerate;
+        double tb = fmod(t, 0.5);
+        double kick = exp(-tb * 12.0) * sin(2 * M_PI * 55.0 * tb);
+        // noise from a hash of the position, so any window is reproducible
+        unsigned long long x = (pos ^ SYNTH_SEED) * 6364136223846793005ull + 1442695040888963407ull;
+        x ^= x >> 33;
+        double noise = (x & 0xffff) / 32768.0 - 1.0;
+        double th = fmod(t + 0.25, 0.5);
+        double hat = exp(-th * 60.0) * noise;
+        // f(t) = f0 k^(t/T), phase is its integral
+        const double f0 = 40.0, k = 250.0, T = 8.0;
+        double ts = fmod(t, T);
+        double sweep = 0.25 * sin(2 * M_PI * f0 * T / log(k) * (pow(k, ts / T) - 1));
+        double l = 0.6 * kick + 0.2 * hat + sweep + 0.05 * noise;
+        double r = 0.6 * kick + 0.15 * hat + 0.8 * sweep - 0.05 * noise;
+        pcm[2 * i] = (short)(l * 32000);
+        pcm[2 * i + 1] = (short)(r * 32000);
+    }
+}
+
+bool pmSynthName(const std::string &path, double &seconds) {
+    if (path.compare(0, 6, "synth:") != 0) return false;
+    char *end;
+    seconds = strtod(path.c_str() + 6, &end);
+    return end != path.c_str() + 6 && *end == 0 && seconds > 0;
+}
+
+// Virtual file of raw 16 bit stereo frames, synthesized on every read
+// from the byte position, so it costs no memory whatever its length.
+namespace {
+
+const int SYNTH_RATE = 44100;
+const int SYNTH_FRAME = 2 * sizeof(short);
+
+struct SynthFile {
+    sf_count_t pos, len;
+};
+std::vector<std::unique_ptr<SynthFile> > synthFiles;   // live as long as we do
+
+sf_count_t synthLength(void *user) {
+    return ((SynthFile *)user)->len;
+}
+
+sf_count_t synthSeek(sf_count_t offset, int whence, void *user) {
+    SynthFile *f = (SynthFile *)user;
+    sf_count_t pos = whence == SEEK_SET ? offset : whence == SEEK_CUR ? f->pos + offset : f->len + offset;
+    f->pos = pos < 0 ? 0 : pos > f->len ? f->len : pos;
+    return f->pos;
+}
+
+sf_count_t synthRead(void *ptr, sf_count_t count, void *user) {
+    SynthFile *f = (SynthFile *)user;
+    if (count > f->len - f->pos) count = f->len - f->pos;
+    short frames[2 * 256];
+    sf_count_t done = 0;
+    while (done < count) {
+        // reads need not start on a frame boundary
+        unsigned long long pos = f->pos / SYNTH_FRAME;
+        int skip = f->pos % SYNTH_FRAME;
+        sf_count_t want = std::min<sf_count_t>(256, (count - done + skip + SYNTH_FRAME - 1) / SYNTH_FRAME);
+        pmSynthAudio(frames, want, SYNTH_RATE, pos);
+        sf_count_t take = std::min<sf_count_t>(want * SYNTH_FRAME - skip, count - done);
+        memcpy((char *)ptr + done, (char *)frames + skip, take);
+        done += take;
+        f->pos += take;
+    }
+    return count;
+}
+
+sf_count_t synthWrite(const void *, sf_count_t, void *) {
+    return 0;
+}
+
+sf_count_t synthTell(void *user) {
+    return ((SynthFile *)user)->pos;
+}
+
+}
+
+SNDFILE *pmSynthOpen(double seconds, SF_INFO *info) {
+    static SF_VIRTUAL_IO vio = { synthLength, synthSeek, synthRead, synthWrite, synthTell };
+    std::unique_ptr<SynthFile> f(new SynthFile);
+    f->pos = 0;
+    f->len = (sf_count_t)(seconds * SYNTH_RATE) * SYNTH_FRAME;
+    memset(info, 0, sizeof(*info));
+    info->samplerate = SYNTH_RATE;
+    info->channels = 2;
+    info->format = SF_FORMAT_RAW | SF_FORMAT_PCM_16 | SF_ENDIAN_CPU;
+    SNDFILE *sndf = sf_open_virtual(&vio, SFM_READ, info, f.get());
+    if (sndf != NULL) synthFiles.push_back(std::move(f));
+    return sndf;
+}
+
+pmBench::pmBench(projectMSND *_app, int _frames, int _samplerate, int fps) {
+    app = _app;
+    frames = _frames;
+    samplerate = _samplerate;
+    asamples = samplerate / fps;
+    pcm.resize(asamples * 2);
+    glGenQueries(1, &query);
+}
+
+pmBench::~pmBench() {
+    glDeleteQueries(1, &query);
+}
+
+static void stats(std::vector<double> &v, double &mean, double &p99) {
+    mean = p99 = 0;
+    if (v.empty()) return;
+    for (size_t i = 0; i < v.size(); i++) mean += v[i];
+    mean /= v.size();
+    std::sort(v.begin(), v.end());
+    p99 = v[std::min(v.size() - 1, (size_t)(v.size() * 0.99))];
+}
+
+pmBenchResult pmBench::run(unsigned int index) {
+    pmBenchResult r;
+    r.index = index;
+    r.name = app->getPresetName(index);
+
+    // every preset hears the same window of the test signal
+    unsigned long long pos = 0;
+    pmSynthAudio(pcm.data(), asamples, samplerate, pos);
+    app->pcm()->addPCM16Data(pcm.data(), asamples);
+
+    unsigned long long t0 = nowns();
+    app->selectPreset(index, true);
+    app->setPresetLock(1);
+    app->renderFrame(false);
+    glFinish();
+    r.loadms = (nowns() - t0) / 1e6;
+    r.error = app->getErrorLoadingCurrentPreset();
+
+    std::vector<double> cpu, gpu;
+    for (int f = 0; f < frames; f++) {
+        pmSynthAudio(pcm.data(), asamples, samplerate, pos);
+        app->pcm()->addPCM16Data(pcm.data(), asamples);
+        t0 = nowns();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        app->renderFrame(false);
+        glEndQuery(GL_TIME_ELAPSED);
+        cpu.push_back((nowns() - t0) / 1e6);
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        gpu.push_back(ns / 1e6);
+    }
+    stats(cpu, r.cpumean, r.cpup99);
+    stats(gpu, r.gpumean, r.gpup99);
+    return r;
+}
+
+int pmBench::spawn(int n, std::vector<pid_t> &pids) {
+    for (int i = 0; i < n; i++) {
+        fflush(stdout);
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) return i;
+        pids.push_back(pid);
+        if (pid < 0) std::cerr << "benchmark worker creation error" << std::endl;
+    }
+    return -1;
+}
+
+bool pmBench::writeRows(const std::string &path, const std::vector<pmBenchResult> &results) {
+    std::ofstream out(path.c_str());
+    for (size_t i = 0; i < results.size(); i++) {
+        const pmBenchResult &r = results[i];
+        out << r.index << "\t" << r.error << "\t" << r.loadms << "\t" << r.cpumean << "\t" << r.cpup99
+            << "\t" << r.gpumean << "\t" << r.gpup99 << "\t" << r.name << "\n";
+    }
+    out.close();
+    return (bool)out;
+}
+
+bool pmBench::readRows(const std::string &path, std::vector<pmBenchResult> &results) {
+    std::ifstream in(path.c_str());
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        pmBenchResult r;
+        if (!(ls >> r.index >> r.error >> r.loadms >> r.cpumean >> r.cpup99 >> r.gpumean >> r.gpup99)) continue;
+        ls.get();   // the tab before the name
+        std::getline(ls, r.name);
+        results.push_back(r);
+    }
+    return true;
+}
+
+static std::string csvQuote(const std::string &s) {
+    std::string q = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"') q += '"';
+        q += s[i];
+    }
+    return q + "\"";
+}
+
+static std::string jsonQuote(const std::string &s) {
+    std::string q = "\"";
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            q += '\\';
+            q += c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            q += buf;
+        } else {
+            q += c;
+        }
+    }
+    return q + "\"";
+}
+
+bool pmBench::writeReport(const std::string &path, std::vector<pmBenchResult> results,
+                          double budgetms, std::string &err) {
+    std::sort(results.begin(), results.end(),
+              [](const pmBenchResult &a, const pmBenchResult &b) { return a.index < b.index; });
+    bool json = path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    std::ofstream out(path.c_str());
+    if (json) out << "[\n";
+    else out << "index,name,error,load_ms,cpu_mean_ms,cpu_p99_ms,gpu_mean_ms,gpu_p99_ms,fits_budget\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const pmBenchResult &r = results[i];
+        // CPU and GPU work of a frame are serialized in this renderer
+        bool fits = !r.error && r.cpumean + r.gpumean <= budgetms;
+        if (json) {
+            out << "  {\"index\": " << r.index << ", \"name\": " << jsonQuote(r.name)
+                << ", \"error\": " << (r.error ? "true" : "false") << ", \"load_ms\": " << r.loadms
+                << ", \"cpu_mean_ms\": " << r.cpumean << ", \"cpu_p99_ms\": " << r.cpup99
+                << ", \"gpu_mean_ms\": " << r.gpumean << ", \"gpu_p99_ms\": " << r.gpup99
+                << ", \"fits_budget\": " << (fits ? "true" : "false") << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        } else {
+            out << r.index << "," << csvQuote(r.name) << "," << r.error << "," << r.loadms << ","
+                << r.cpumean << "," << r.cpup99 << "," << r.gpumean << "," << r.gpup99 << "," << fits << "\n";
+        }
+    }
+    if (json) out << "]\n";
+    out.close();
+    if (!out) {
+        err = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool pmBench::appendRun(const std::string &path, const pmRunStats &run, std::string &err) {
+    std::ofstream out(path.c_str(), std::ios::app);
+    // MB/s over the time actually spent in the stage, not wall time, so
+    // a slow renderer does not make the readback look slow
+    double readms = pmTrace::totalms(pmTrace::CAPTURE) + pmTrace::totalms(pmTrace::MAP);
+    double encms = pmTrace::count(pmTrace::PIPE) > 0 ? pmTrace::totalms(pmTrace::PIPE) : pmTrace::totalms(pmTrace::SEND);
+    double mb = run.bytes / 1e6;
+    char buf[4096];
+    snprintf(buf, sizeof(buf),
+             "{\"audio\": %s, \"preset\": %s, \"encoder\": %s, \"width\": %d, \"height\": %d, \"out_width\": %d, \"out_height\": %d, "
+             "\"frames\": %llu, \"seconds\": %.3f, \"fps\": %.2f, \"cpu_user_s\": %.3f, \"cpu_sys_s\": %.3f, "
+             "\"frame_ms_p50\": %.3f, \"frame_ms_p90\": %.3f, \"frame_ms_p99\": %.3f, \"frame_ms_max\": %.3f, "
+             "\"gpu_ms_p50\": %.3f, \"gpu_ms_p99\": %.3f, "
+             "\"readback_mbps\": %.1f, \"encode_mbps\": %.1f}\n",
+             jsonQuote(run.audio).c_str(), jsonQuote(run.preset).c_str(), jsonQuote(run.encoder).c_str(),
+             run.width, run.height, run.outwidth, run.outheight, run.frames, run.seconds, run.seconds > 0 ? run.frames / run.seconds : 0,
+             run.cpuuser, run.cpusys,
+             pmTrace::percentile(pmTrace::FRAME, 0.5), pmTrace::percentile(pmTrace::FRAME, 0.9),
+             pmTrace::percentile(pmTrace::FRAME, 0.99), pmTrace::percentile(pmTrace::FRAME, 1.0),
+             pmTrace::percentile(pmTrace::GPU_FRAME, 0.5), pmTrace::percentile(pmTrace::GPU_FRAME, 0.99),
+             readms > 0 ? mb / (readms / 1e3) : 0, encms > 0 ? mb / (encms / 1e3) : 0);
+    out << buf;
+    out.close();
+    if (!out) {
+        err = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
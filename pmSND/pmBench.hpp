@@ -0,0 +1,107 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmBench.hpp
+* Preset benchmark (--bench-presets): every preset is loaded and driven
+* with the same synthetic audio for a fixed number of frames while CPU
+* and GPU frame times are measured, so presets too slow for the target
+* frame rate at a given resolution can be culled.
+*
+* The same test signal is available to the normal render path as the
+* audio file synth:SECONDS, which with --bench-json makes a throughput
+* benchmark of a whole export (see the bench target in the Makefile).
+*
+*/
+
+
+#ifndef pmBench_hpp
+#define pmBench_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/types.h>
+#include <sndfile.h>
+
+#include "pmSND.hpp"
+
+struct pmBenchResult {
+    int index;
+    std::string name;
+    bool error;             // libprojectM reported a load error
+    double loadms;          // selectPreset plus the first frame, GPU finished
+    double cpumean, cpup99; // renderFrame() on the CPU
+    double gpumean, gpup99; // GL_TIME_ELAPSED around renderFrame()
+};
+
+// Deterministic test signal: a beat train (a kick every half second, a
+// noise hat on the off-beats), a logarithmic sweep from 40 Hz to 10 kHz
+// every eight seconds and seeded noise, all a function of the sample
+// position pos, which is advanced by nframes. Interleaved stereo.
+void pmSynthAudio(short *pcm, int nframes, int samplerate, unsigned long long &pos);
+
+// The test signal as an audio file: "synth:SECONDS" names it, and it
+// opens as 16 bit stereo at 44.1 kHz through libsndfile's virtual I/O,
+// so it goes through the same decoder as any file.
+bool pmSynthName(const std::string &path, double &seconds);
+SNDFILE *pmSynthOpen(double seconds, SF_INFO *info);
+
+// Throughput of a whole run, for --bench-json.
+struct pmRunStats {
+    std::string audio, preset, encoder;
+    int width, height;          // rendered
+    int outwidth, outheight;    // encoded
+    unsigned long long frames;
+    unsigned long long bytes;   // read back from the GPU and encoded
+    double seconds;
+    double cpuuser, cpusys;     // process CPU time (getrusage)
+};
+
+class pmBench {
+public:
+    pmBench(projectMSND *app, int frames, int samplerate, int fps);
+    ~pmBench();
+
+    pmBenchResult run(unsigned int index);
+
+    // Fork n workers; returns the worker number in each of them and -1 in
+    // the parent, which gets their pids.
+    static int spawn(int n, std::vector<pid_t> &pids);
+    // What a worker hands the parent: one tab separated line per preset.
+    static bool writeRows(const std::string &path, const std::vector<pmBenchResult> &results);
+    static bool readRows(const std::string &path, std::vector<pmBenchResult> &results);
+    // CSV, or JSON if path ends in .json. budgetms is the frame time the
+    // fits column is judged against.
+    static bool writeReport(const std::string &path, std::vector<pmBenchResult> results,
+                            double budgetms, std::string &err);
+    // Append run as one JSON line to path, with frame time percentiles and
+    // readback/encode rates from the pmTrace stage timings.
+    static bool appendRun(const std::string &path, const pmRunStats &run, std::string &err);
+
+private:
+    projectMSND *app;
+    int frames, samplerate, asamples;
+    unsigned int query;
+    std::vector<short> pcm;
+};
+
+#endif /* pmBench_hpp */
@@ -0,0 +1,148 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmEGL.cpp
+*
+*/
+
+#include <cstring>
+
+#include "pmEGL.hpp"
+#include <EGL/eglext.h>
+
+pmEGL::pmEGL() {
+    width = height = 0;
+    dpy = EGL_NO_DISPLAY;
+    surf = EGL_NO_SURFACE;
+    ctx = EGL_NO_CONTEXT;
+}
+
+pmEGL::~pmEGL() {
+    destroy();
+}
+
+static EGLDisplay getDisplay() {
+    // Prefer the Mesa surfaceless platform: it needs neither X nor a DRM
+    // master, which is what render boxes and containers usually lack.
+    const char *cext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (cext != NULL && strstr(cext, "EGL_MESA_platform_surfaceless") != NULL) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL) {
+            EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (d != EGL_NO_DISPLAY) return d;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool pmEGL::init(int w, int h, std::string &err) {
+    width = w;
+    height = h;
+
+    dpy = getDisplay();
+    if (dpy == EGL_NO_DISPLAY) {
+        err = "no EGL display";
+        return false;
+    }
+
+    EGLint major, minor;
+    if (!eglInitialize(dpy, &major, &minor)) {
+        err = "eglInitialize failed";
+        return false;
+    }
+
+    const EGLint cfgattr[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig cfg;
+    EGLint ncfg = 0;
+    if (!eglChooseConfig(dpy, cfgattr, &cfg, 1, &ncfg) || ncfg < 1) {
+        err = "no EGL config with pbuffer and desktop GL support";
+        return false;
+    }
+
+    const EGLint pbattr[] = {
+        EGL_WIDTH, width,
+        EGL_HEIGHT, height,
+        EGL_NONE
+    };
+    surf = eglCreatePbufferSurface(dpy, cfg, pbattr);
+    if (surf == EGL_NO_SURFACE) {
+        err = "cannot create EGL pbuffer surface";
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        err = "desktop OpenGL is not available through EGL";
+        return false;
+    }
+
+    // DSA calls in the export path want 4.5; fall back to 3.3 which
+    // is the minimum projectM itself needs.
+    const EGLint versions[][2] = { {4, 5}, {3, 3} };
+    for (const EGLint *v : versions) {
+        const EGLint ctxattr[] = {
+            EGL_CONTEXT_MAJOR_VERSION, v[0],
+            EGL_CONTEXT_MINOR_VERSION, v[1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        ctx = eglCreateContext(dpy, cfg, EGL_NO_CONTEXT, ctxattr);
+        if (ctx != EGL_NO_CONTEXT) break;
+    }
+    if (ctx == EGL_NO_CONTEXT) {
+        err = "cannot create EGL OpenGL context";
+        return false;
+    }
+
+    if (!makeCurrent()) {
+        err = "eglMakeCurrent failed";
+        return false;
+    }
+
+    // Nothing is ever presented, so never wait for a retrace either.
+    eglSwapInterval(dpy, 0);
+    return true;
+}
+
+bool pmEGL::makeCurrent() {
+    return eglMakeCurrent(dpy, surf, surf, ctx) == EGL_TRUE;
+}
+
+void pmEGL::destroy() {
+    if (dpy == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (ctx != EGL_NO_CONTEXT) eglDestroyContext(dpy, ctx);
+    if (surf != EGL_NO_SURFACE) eglDestroySurface(dpy, surf);
+    eglTerminate(dpy);
+    ctx = EGL_NO_CONTEXT;
+    surf = EGL_NO_SURFACE;
+    dpy = EGL_NO_DISPLAY;
+}
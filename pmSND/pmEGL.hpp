@@ -0,0 +1,55 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmEGL.hpp
+* Headless OpenGL context: an EGL pbuffer surface with no window and no
+* display server, used to render video without throttling to vsync.
+*
+*/
+
+
+#ifndef pmEGL_hpp
+#define pmEGL_hpp
+
+#include <string>
+#include <EGL/egl.h>
+
+class pmEGL {
+public:
+    pmEGL();
+    ~pmEGL();
+
+    // Create a pbuffer surface of the given size and a desktop GL context
+    // current on it. Returns false and fills err on failure.
+    bool init(int width, int height, std::string &err);
+    bool makeCurrent();
+    void destroy();
+
+    int width, height;
+
+private:
+    EGLDisplay dpy;
+    EGLSurface surf;
+    EGLContext ctx;
+};
+
+#endif /* pmEGL_hpp */
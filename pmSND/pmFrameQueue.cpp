@@ -0,0 +1,274 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmFrameQueue.cpp
+*
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+
+#include "pmFrameQueue.hpp"
+#include "pmTrace.hpp"
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+pmFrameQueue::pmFrameQueue() {
+    fd = -1;
+    bufsz = 0;
+    freehead = freecnt = fullhead = fullcnt = inflhead = inflcnt = 0;
+    usesplice = false;
+    pipesz = 0;
+    spliced = 0;
+    stopping = false;
+    error = 0;
+    frames = bytes = waits = waitns = maxqueued = 0;
+    syscalls = busyns = 0;
+}
+
+pmFrameQueue::~pmFrameQueue() {
+    finish();
+    for (Frame &f : pool) {
+        free(f.data);
+    }
+}
+
+// Grow the pipe towards one frame, as far as pipe-max-size lets an
+// unprivileged process go; the default 64 KiB means a context switch
+// to ffmpeg every 16 pages.
+static int growPipe(int fd, size_t want) {
+    long maxsz = 1048576;
+    std::ifstream f("/proc/sys/fs/pipe-max-size");
+    f >> maxsz;
+    long sz = want < (size_t)maxsz ? want : maxsz;
+    while (sz > 65536 && fcntl(fd, F_SETPIPE_SZ, sz) < 0) {
+        sz /= 2;
+    }
+    return fcntl(fd, F_GETPIPE_SZ);
+}
+
+void pmFrameQueue::start(int _fd, size_t _bufsz, int nbufs, bool splice) {
+    fd = _fd;
+    bufsz = _bufsz;
+    if (nbufs < 2) nbufs = 2;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        pipesz = growPipe(fd, bufsz);
+        usesplice = splice;
+    }
+
+    // page aligned so the buffers can be handed to the kernel as is
+    long pgsz = sysconf(_SC_PAGESIZE);
+    pool.resize(nbufs);
+    freeq.resize(nbufs);
+    fullq.resize(nbufs);
+    inflq.resize(nbufs);
+    inflend.resize(nbufs);
+    for (int i = 0; i < nbufs; i++) {
+        if (posix_memalign((void **)&pool[i].data, pgsz, bufsz) != 0) {
+            std::cerr << "cannot allocate encoder frame buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memset(pool[i].data, 0, bufsz); // fault the pages in now, not mid-render
+        pool[i].len = 0;
+        freeq[i] = i;
+    }
+    freehead = fullhead = fullcnt = inflhead = inflcnt = 0;
+    freecnt = nbufs;
+    spliced = 0;
+
+    writer = std::thread(&pmFrameQueue::run, this);
+}
+
+unsigned char *pmFrameQueue::acquire() {
+    std::unique_lock<std::mutex> lk(mtx);
+    if (freecnt == 0 && !error) {
+        unsigned long long t0 = nowns();
+        cvfree.wait(lk, [this] { return freecnt > 0 || error; });
+        waits++;
+        waitns += nowns() - t0;
+    }
+    if (error) return NULL;
+    int i = freeq[freehead];
+    freehead = (freehead + 1) % freeq.size();
+    freecnt--;
+    return pool[i].data;
+}
+
+void pmFrameQueue::push(unsigned char *buf, size_t len) {
+    std::unique_lock<std::mutex> lk(mtx);
+    int i = 0;
+    while (pool[i].data != buf) i++;
+    pool[i].len = len;
+    fullq[(fullhead + fullcnt) % fullq.size()] = i;
+    fullcnt++;
+    if (fullcnt > maxqueued) maxqueued = fullcnt;
+    cvfull.notify_one();
+}
+
+void pmFrameQueue::finish() {
+    if (!writer.joinable()) return;
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        stopping = true;
+        cvfull.notify_one();
+    }
+    writer.join();
+    if (usesplice && !error) {
+        drainPipe();
+    }
+}
+
+// Loop over short writes and EINTR: a pipe takes at most its capacity
+// per call, far less than one frame.
+bool pmFrameQueue::transfer(unsigned char *p, size_t len) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    bool ok = true;
+    while (len > 0) {
+        ssize_t rc;
+        if (usesplice) {
+            struct iovec iov = { p, len };
+            rc = vmsplice(fd, &iov, 1, 0);
+        } else {
+            rc = write(fd, p, len);
+        }
+        syscalls++;
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            ok = false;
+            break;
+        }
+        p += rc;
+        len -= rc;
+        if (usesplice) spliced += rc;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    busyns += (t1.tv_sec - t0.tv_sec) * 1000000000ull + t1.tv_nsec - t0.tv_nsec;
+    pmTrace::record(pmTrace::PIPE, t0.tv_sec * 1000000000ull + t0.tv_nsec, t1.tv_sec * 1000000000ull + t1.tv_nsec);
+    return ok;
+}
+
+void pmFrameQueue::release(int i) {
+    freeq[(freehead + freecnt) % freeq.size()] = i;
+    freecnt++;
+    cvfree.notify_one();
+}
+
+// Return spliced buffers whose bytes the reader has already taken out
+// of the pipe; called with mtx held.
+void pmFrameQueue::reclaim() {
+    int queued = 0;
+    if (ioctl(fd, FIONREAD, &queued) < 0) return;
+    unsigned long long consumed = spliced - queued;
+    while (inflcnt > 0 && inflend[inflhead] <= consumed) {
+        release(inflq[inflhead]);
+        inflhead = (inflhead + 1) % inflq.size();
+        inflcnt--;
+    }
+}
+
+// The pipe still references pages of our pool; keep them alive and
+// unmodified until the reader is done, or stops making progress.
+void pmFrameQueue::drainPipe() {
+    int queued = 0, last = -1;
+    auto stalled = std::chrono::steady_clock::now();
+    while (ioctl(fd, FIONREAD, &queued) == 0 && queued > 0) {
+        if (queued != last) {
+            last = queued;
+            stalled = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - stalled > std::chrono::seconds(5)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void pmFrameQueue::run() {
+    pmTrace::nameThread("encoder pipe");
+    for (;;) {
+        int i;
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            while (fullcnt == 0 && !stopping) {
+                if (inflcnt > 0) {
+                    // nothing to send, but spliced buffers to give back
+                    // as soon as the reader gets through them
+                    cvfull.wait_for(lk, std::chrono::milliseconds(1));
+                    reclaim();
+                } else {
+                    cvfull.wait(lk);
+                }
+            }
+            if (fullcnt == 0) break;
+            i = fullq[fullhead];
+        }
+
+        int werr = transfer(pool[i].data, pool[i].len) ? 0 : errno;
+
+        std::unique_lock<std::mutex> lk(mtx);
+        if (werr) {
+            error = werr;
+            std::cerr << "error writing to encoder pipe " << strerror(error) << std::endl;
+            cvfree.notify_all();
+            break;
+        }
+        frames++;
+        bytes += pool[i].len;
+        fullhead = (fullhead + 1) % fullq.size();
+        fullcnt--;
+        if (usesplice) {
+            inflq[(inflhead + inflcnt) % inflq.size()] = i;
+            inflend[(inflhead + inflcnt) % inflq.size()] = spliced;
+            inflcnt++;
+            reclaim();
+        } else {
+            release(i);
+        }
+    }
+}
+
+void pmFrameQueue::report(std::ostream &os, const char *name) const {
+    std::unique_lock<std::mutex> lk(mtx);
+    os << "Encoder queue (" << name << "): " << pool.size() << " buffers, "
+       << frames << " frames, " << bytes / 1048576.0 << " MB written, "
+       << "max queued " << maxqueued << ", render waited " << waits
+       << " times for " << waitns / 1000000.0 << " ms" << std::endl;
+    os << "  " << (usesplice ? "vmsplice" : "write") << " into "
+       << (pipesz ? std::to_string(pipesz / 1024) + " KiB pipe" : std::string("file")) << ": "
+       << (frames ? (double)syscalls / frames : 0) << " syscalls/frame, "
+       << (busyns ? bytes / 1048576.0 / (busyns / 1e9) : 0) << " MB/s while transferring" << std::endl;
+}
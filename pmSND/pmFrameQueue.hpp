@@ -0,0 +1,101 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmFrameQueue.hpp
+* Encoder feed: a fixed pool of frame buffers cycled between the render
+* thread, which fills them, and a writer thread, which drains them into
+* the encoder pipe. On a pipe the buffers are handed over with vmsplice,
+* so the kernel maps our pages instead of copying them.
+*
+*/
+
+
+#ifndef pmFrameQueue_hpp
+#define pmFrameQueue_hpp
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+class pmFrameQueue {
+public:
+    pmFrameQueue();
+    ~pmFrameQueue();
+
+    // Allocate nbufs buffers of bufsz bytes and start writing to fd.
+    // If fd is a pipe it is enlarged, and with splice set the buffers
+    // are vmspliced rather than written.
+    void start(int fd, size_t bufsz, int nbufs, bool splice = true);
+
+    // Get an empty buffer to fill. Blocks while every buffer is queued
+    // for writing, which is how a slow encoder throttles the renderer.
+    // Returns NULL once the writer has failed.
+    unsigned char *acquire();
+    // Queue a buffer obtained from acquire() for writing.
+    void push(unsigned char *buf, size_t len);
+
+    // Write out everything queued and stop the writer thread.
+    void finish();
+    bool failed() const { return error != 0; }
+
+    void report(std::ostream &os, const char *name) const;
+
+    size_t bufsz;
+
+private:
+    struct Frame {
+        unsigned char *data;
+        size_t len;
+    };
+
+    int fd;
+    std::vector<Frame> pool;
+    // free, queued and in-flight are fixed-size rings of pool indices;
+    // in-flight buffers were vmspliced and the reader has not consumed
+    // them yet, so they must not be overwritten.
+    std::vector<int> freeq, fullq, inflq;
+    std::vector<unsigned long long> inflend;
+    unsigned int freehead, freecnt, fullhead, fullcnt, inflhead, inflcnt;
+    bool usesplice;
+    int pipesz;
+    unsigned long long spliced;
+    bool stopping;
+    std::atomic<int> error;
+
+    std::thread writer;
+    mutable std::mutex mtx;
+    std::condition_variable cvfree, cvfull;
+
+    unsigned long long frames, bytes, waits, waitns, maxqueued;
+    unsigned long long syscalls, busyns;
+
+    void run();
+    bool transfer(unsigned char *p, size_t len);
+    void release(int i);
+    void reclaim();
+    void drainPipe();
+};
+
+#endif /* pmFrameQueue_hpp */
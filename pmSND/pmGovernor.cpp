@@ -0,0 +1,118 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmGovernor.cpp
+*
+*/
+
+#include <algorithm>
+
+#include "pmGovernor.hpp"
+
+// fractions of the budget: above DOWN quality drops, below UP for
+// UPWINDOWS windows in a row it rises again
+static const double DOWN = 0.85, UP = 0.5;
+static const int UPWINDOWS = 4;
+
+pmGovernor::pmGovernor() {
+    level = 0;
+    scale = 1.0f;
+    textureSize = 0;
+    p90 = 0;
+    nwindow = 0;
+    budgetms = 0;
+    calm = 0;
+    settling = false;
+    downs = ups = frames = 0;
+}
+
+void pmGovernor::start(int fps, float minscale, int texturesize, int mintexture) {
+    float s = 1.0f;
+    int t = texturesize;
+    levels.clear();
+    levels.push_back(Level{s, t});
+    for (int i = 1; ; i++) {
+        if (i % 3 == 0 && t / 2 >= mintexture) {
+            t /= 2;
+        } else if (s * 0.85f >= minscale) {
+            s *= 0.85f;
+        } else if (t / 2 >= mintexture) {
+            t /= 2;
+        } else {
+            break;
+        }
+        levels.push_back(Level{s, t});
+    }
+    framesAt.assign(levels.size(), 0);
+    level = 0;
+    scale = levels[0].scale;
+    textureSize = levels[0].textureSize;
+    budgetms = 1000.0 / fps;
+    nwindow = fps / 2 > 1 ? fps / 2 : 1;
+    window.clear();
+    calm = 0;
+    settling = false;
+}
+
+bool pmGovernor::frame(double workms) {
+    if (levels.empty()) return false;
+    frames++;
+    framesAt[level]++;
+    window.push_back(workms);
+    if (window.size() < nwindow) return false;
+
+    std::sort(window.begin(), window.end());
+    p90 = window[window.size() * 9 / 10];
+    window.clear();
+    if (settling) {
+        settling = false;
+        return false;
+    }
+
+    int next = level;
+    if (p90 > DOWN * budgetms) {
+        calm = 0;
+        if (level + 1 < (int)levels.size()) next = level + 1;
+    } else if (p90 < UP * budgetms) {
+        if (++calm >= UPWINDOWS && level > 0) next = level - 1;
+    } else {
+        calm = 0;
+    }
+    if (next == level) return false;
+
+    (next > level ? downs : ups)++;
+    level = next;
+    scale = levels[level].scale;
+    textureSize = levels[level].textureSize;
+    calm = 0;
+    settling = true;
+    return true;
+}
+
+void pmGovernor::report(std::ostream &os) const {
+    if (levels.empty()) return;
+    os << "Quality governor: " << downs << " steps down, " << ups << " up; frames per level:";
+    for (size_t i = 0; i < levels.size(); i++) {
+        os << " " << framesAt[i];
+    }
+    os << std::endl;
+}
@@ -0,0 +1,76 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmGovernor.hpp
+* Adaptive quality for live mode: frame work times (everything but the
+* pacing sleep) are compared with the frame budget every half second.
+* When the 90th percentile gets close to the budget, quality drops one
+* level; after two seconds of ample headroom it goes back up one. Levels
+* lower the render scale (the frame is rendered smaller and stretched to
+* the window) and, every third step, halve the texture size, down to the
+* configured bounds.
+*
+* libprojectM 3.1 takes the mesh size only at construction, so the
+* per-vertex mesh is not one of the knobs.
+*
+*/
+
+
+#ifndef pmGovernor_hpp
+#define pmGovernor_hpp
+
+#include <vector>
+#include <iostream>
+
+class pmGovernor {
+public:
+    pmGovernor();
+
+    void start(int fps, float minscale, int texturesize, int mintexture);
+
+    // Work time of one rendered frame. True when the level has changed
+    // and scale/textureSize are to be applied.
+    bool frame(double workms);
+
+    void report(std::ostream &os) const;
+
+    int level;
+    float scale;
+    int textureSize;
+    double p90;         // of the window that made the last decision
+
+private:
+    struct Level {
+        float scale;
+        int textureSize;
+    };
+    std::vector<Level> levels;
+    std::vector<double> window;
+    size_t nwindow;     // frames per decision
+    double budgetms;
+    int calm;           // consecutive windows with headroom
+    bool settling;      // first window after a change is not judged
+    unsigned long long downs, ups, frames;
+    std::vector<unsigned long long> framesAt;   // per level
+};
+
+#endif /* pmGovernor_hpp */
@@ -0,0 +1,149 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmGpuTimer.cpp
+*
+*/
+
+#include <string.h>
+#include <vector>
+
+#include "projectM-opengl.h"
+#include "pmGpuTimer.hpp"
+
+namespace {
+
+const int DEPTH = 4;        // frames in flight before a slot is read
+const int MAXSPANS = 16;    // GPU stages per frame, renditions included
+
+struct Span {
+    pmTrace::Stage stage;
+    GLuint q[2];            // timestamp queries before and after
+};
+
+struct Frame {
+    Span spans[MAXSPANS];
+    int nspans;
+};
+
+bool enabled = false;
+std::vector<Frame> frames;
+unsigned int cur = 0;       // slot being recorded
+int open = -1;              // span begun but not ended
+long long offsetns = 0;     // CPU monotonic minus GPU timestamp
+unsigned int sincecal = 0;
+unsigned long long dropped = 0;
+
+void calibrate() {
+    GLint64 gpu;
+    glGetInteger64v(GL_TIMESTAMP, &gpu);
+    offsetns = (long long)pmTrace::now() - gpu;
+    sincecal = 0;
+}
+
+// Record the spans of slot f; without wait only if the GPU is done
+// with all of them, else give the frame up.
+void collect(Frame &f, bool wait) {
+    if (f.nspans == 0) return;
+    if (!wait) {
+        GLint avail = 0;
+        glGetQueryObjectiv(f.spans[f.nspans - 1].q[1], GL_QUERY_RESULT_AVAILABLE, &avail);
+        if (!avail) {
+            dropped++;
+            f.nspans = 0;
+            return;
+        }
+    }
+    GLuint64 first = 0, last = 0;
+    for (int i = 0; i < f.nspans; i++) {
+        GLuint64 t0, t1;
+        glGetQueryObjectui64v(f.spans[i].q[0], GL_QUERY_RESULT, &t0);
+        glGetQueryObjectui64v(f.spans[i].q[1], GL_QUERY_RESULT, &t1);
+        pmTrace::recordGpu(f.spans[i].stage, t0 + offsetns, t1 + offsetns);
+        if (i == 0) first = t0;
+        last = t1;
+    }
+    pmTrace::recordGpu(pmTrace::GPU_FRAME, first + offsetns, last + offsetns);
+    f.nspans = 0;
+}
+
+}
+
+void pmGpuTimer::init() {
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if (glGetError() != GL_NO_ERROR || bits == 0) return;
+    frames.resize(DEPTH);
+    for (int i = 0; i < DEPTH; i++) {
+        frames[i].nspans = 0;
+        for (int j = 0; j < MAXSPANS; j++) {
+            glGenQueries(2, frames[i].spans[j].q);
+        }
+    }
+    cur = 0;
+    open = -1;
+    calibrate();
+    enabled = true;
+}
+
+void pmGpuTimer::destroy() {
+    if (!enabled) return;
+    for (int i = 1; i <= DEPTH; i++) {
+        collect(frames[(cur + i) % DEPTH], true);
+    }
+    for (int i = 0; i < DEPTH; i++) {
+        for (int j = 0; j < MAXSPANS; j++) {
+            glDeleteQueries(2, frames[i].spans[j].q);
+        }
+    }
+    frames.clear();
+    enabled = false;
+    if (dropped > 0) {
+        std::cout << "GPU timer: " << dropped << " frames not ready after " << DEPTH << " frames, not counted" << std::endl;
+    }
+}
+
+void pmGpuTimer::begin(pmTrace::Stage stage) {
+    if (!enabled || open >= 0) return;
+    Frame &f = frames[cur];
+    if (f.nspans == MAXSPANS) return;
+    open = f.nspans++;
+    f.spans[open].stage = stage;
+    glQueryCounter(f.spans[open].q[0], GL_TIMESTAMP);
+}
+
+void pmGpuTimer::end() {
+    if (!enabled || open < 0) return;
+    glQueryCounter(frames[cur].spans[open].q[1], GL_TIMESTAMP);
+    open = -1;
+}
+
+void pmGpuTimer::endFrame() {
+    if (!enabled) return;
+    end();
+    cur = (cur + 1) % DEPTH;
+    // the slot about to be reused holds the frame from DEPTH frames ago
+    collect(frames[cur], false);
+    // GPU and CPU clocks drift apart slowly; a query now and then keeps
+    // the trace aligned
+    if (++sincecal == 1000) calibrate();
+}
@@ -0,0 +1,62 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmGpuTimer.hpp
+* GPU stage timing: GL_TIMESTAMP queries written before and after each
+* GPU stage go into a ring a few frames deep and are only read back once
+* the GPU has passed them, so timing never stalls the pipeline. Results
+* feed the GPU rows of the pmTrace histograms and trace, converted to the
+* CPU's monotonic clock so both line up in a trace viewer.
+*
+* Timestamps rather than GL_TIME_ELAPSED so that stages may nest in, or
+* run inside, an elapsed-time query of someone else's (pmBench).
+*
+*/
+
+
+#ifndef pmGpuTimer_hpp
+#define pmGpuTimer_hpp
+
+#include "pmTrace.hpp"
+
+namespace pmGpuTimer {
+    // Needs a current context with timer queries; does nothing otherwise.
+    void init();
+    // Read every outstanding query (blocking) and free them.
+    void destroy();
+
+    // Bracket one GPU stage; stages of a frame must not overlap.
+    void begin(pmTrace::Stage stage);
+    void end();
+    // Close the frame's spans and collect those of the oldest frame.
+    void endFrame();
+
+    class Scope {
+    public:
+        Scope(pmTrace::Stage s) { begin(s); }
+        ~Scope() { end(); }
+    };
+}
+
+#define PM_GPU_TRACE(stage) pmGpuTimer::Scope PM_TRACE_VAR(__LINE__)(pmTrace::stage)
+
+#endif /* pmGpuTimer_hpp */
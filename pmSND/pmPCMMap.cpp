@@ -0,0 +1,135 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPCMMap.cpp
+*
+*/
+
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pmPCMMap.hpp"
+
+pmPCMMap::pmPCMMap() {
+    data = NULL;
+    frames = 0;
+    framesize = 0;
+    map = NULL;
+    maplen = offset = released = 0;
+}
+
+pmPCMMap::~pmPCMMap() {
+    close();
+}
+
+static uint32_t le32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Offset and length of the samples in a RIFF/WAVE file of 16 bit PCM,
+// walking the chunks the way the format allows them to be ordered.
+static bool findWavData(const unsigned char *p, size_t len, size_t &off, size_t &datalen) {
+    if (len < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) return false;
+    bool pcm16 = false;
+    size_t pos = 12;
+    while (pos + 8 <= len) {
+        uint32_t size = le32(p + pos + 4);
+        const unsigned char *body = p + pos + 8;
+        if (memcmp(p + pos, "fmt ", 4) == 0 && size >= 16 && pos + 8 + 16 <= len) {
+            // 1 = PCM, 0xfffe = extensible, whose subformat GUID starts with 1
+            unsigned tag = body[0] | body[1] << 8;
+            unsigned bits = body[14] | body[15] << 8;
+            if (tag == 0xfffe && size >= 40 && pos + 8 + 40 <= len) tag = body[24] | body[25] << 8;
+            pcm16 = tag == 1 && bits == 16;
+        } else if (memcmp(p + pos, "data", 4) == 0) {
+            if (!pcm16) return false;
+            off = pos + 8;
+            // streamed WAVs may leave the size unset: the data runs to the end
+            datalen = size == 0 || size == 0xffffffff || off + size > len ? len - off : size;
+            return true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+bool pmPCMMap::open(const std::string &path, const SF_INFO &info) {
+    close();
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    int major = info.format & SF_FORMAT_TYPEMASK;
+    int endian = info.format & SF_FORMAT_ENDMASK;
+    if ((info.format & SF_FORMAT_SUBMASK) != SF_FORMAT_PCM_16) return false;
+    if (major != SF_FORMAT_WAV && major != SF_FORMAT_WAVEX && major != SF_FORMAT_RAW) return false;
+    if (major == SF_FORMAT_RAW && endian != SF_ENDIAN_LITTLE && endian != SF_ENDIAN_CPU) return false;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    maplen = st.st_size;
+    map = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // the mapping keeps the file
+    if (map == MAP_FAILED) {
+        map = NULL;
+        return false;
+    }
+    size_t datalen = maplen;
+    offset = 0;
+    if (major != SF_FORMAT_RAW && !findWavData((const unsigned char *)map, maplen, offset, datalen)) {
+        close();
+        return false;
+    }
+    madvise(map, maplen, MADV_SEQUENTIAL);
+    framesize = 2 * info.channels;
+    frames = datalen / framesize;
+    // trust libsndfile where it is stricter about the length
+    if (info.frames > 0 && info.frames < frames) frames = info.frames;
+    data = (const unsigned char *)map + offset;
+    released = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void pmPCMMap::close() {
+    if (map != NULL) munmap(map, maplen);
+    map = NULL;
+    data = NULL;
+    frames = 0;
+}
+
+void pmPCMMap::release(size_t end) {
+    // whole pages only, and not for every block
+    size_t page = sysconf(_SC_PAGESIZE);
+    end = (offset + end) / page * page;
+    if (map == NULL || end < released + (8 << 20)) return;
+    madvise((char *)map + released, end - released, MADV_DONTNEED);
+    released = end;
+}
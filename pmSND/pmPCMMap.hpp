@@ -0,0 +1,63 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPCMMap.hpp
+* Zero-copy input for uncompressed 16 bit little-endian PCM (WAV, or raw
+* declared with -r): the data chunk is mmap'ed with MADV_SEQUENTIAL and
+* pmAudioReader hands out pointers into the mapping, so the samples go to
+* projectM, ALSA and the encoders without passing through libsndfile's
+* buffers or the prefetch ring. Anything else is decoded as before.
+*
+*/
+
+
+#ifndef pmPCMMap_hpp
+#define pmPCMMap_hpp
+
+#include <string>
+#include <sndfile.h>
+
+class pmPCMMap {
+public:
+    pmPCMMap();
+    ~pmPCMMap();
+
+    // Map path if info (as libsndfile opened it) is a WAV or raw file of
+    // 16 bit little-endian samples; false leaves the file to libsndfile.
+    bool open(const std::string &path, const SF_INFO &info);
+    void close();
+
+    // Pages before byte offset end are no longer needed.
+    void release(size_t end);
+
+    const unsigned char *data;  // first sample frame
+    sf_count_t frames;
+    int framesize;              // bytes per sample frame
+
+private:
+    void *map;
+    size_t maplen;
+    size_t offset;              // of data within the mapping
+    size_t released;
+};
+
+#endif /* pmPCMMap_hpp */
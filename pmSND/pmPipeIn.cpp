@@ -0,0 +1,231 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPipeIn.cpp
+*
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pmPipeIn.hpp"
+
+bool pmPipeName(const std::string &path) {
+    if (path == "-") return true;
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+bool pmRawFormat(const std::string &spec, SF_INFO *info, std::string &err) {
+    int rate, channels, n = 0;
+    char type[8];
+    memset(info, 0, sizeof(*info));
+    if (sscanf(spec.c_str(), "%d:%d:%7[a-z0-9]%n", &rate, &channels, type, &n) != 3 || n != (int)spec.size()
+        || rate <= 0 || channels <= 0) {
+        err = "-r: expected RATE:CHANNELS:s16|f32, got " + spec;
+        return false;
+    }
+    if (strcmp(type, "s16") == 0) {
+        info->format = SF_FORMAT_RAW | SF_FORMAT_PCM_16 | SF_ENDIAN_LITTLE;
+    } else if (strcmp(type, "f32") == 0) {
+        info->format = SF_FORMAT_RAW | SF_FORMAT_FLOAT | SF_ENDIAN_LITTLE;
+    } else {
+        err = std::string("-r: sample type s16 or f32, not ") + type;
+        return false;
+    }
+    info->samplerate = rate;
+    info->channels = channels;
+    return true;
+}
+
+// libsndfile never reads the source itself: a relay thread copies it
+// into a pipe of our own, waiting on the source and on a wakeup pipe at
+// once. pmPipeStop() writes to the latter and the relay closes its end,
+// so a reader blocked on an idle source sees the end of the data instead
+// of hanging until the writer goes away.
+// Headerless data goes through virtual I/O on the read end. libsndfile
+// takes a short read for the end of the data, so reads wait until they
+// are complete; it also asks for the position and may skip forward.
+namespace {
+
+struct PipeFile {
+    int fd;             // read end, what libsndfile reads
+    int out;            // write end, the relay's
+    int src;            // stdin or the fifo
+    int wake[2];
+    bool raw;           // fd is ours to close (sf_open_fd closes its own)
+    sf_count_t pos;
+    SNDFILE *sndf;
+    std::thread relay;
+};
+std::vector<std::unique_ptr<PipeFile> > pipeFiles;     // until pmPipeClose()
+
+// Wait until fd is ready for events, false once woken up.
+bool relayWait(PipeFile *f, int fd, short events) {
+    struct pollfd p[2] = { { fd, events, 0 }, { f->wake[0], POLLIN, 0 } };
+    while (poll(p, 2, -1) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return p[1].revents == 0;
+}
+
+void relayRun(PipeFile *f) {
+    char buf[65536];
+    while (relayWait(f, f->src, POLLIN)) {
+        ssize_t n = read(f->src, buf, sizeof(buf));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) break;
+        for (ssize_t done = 0; done < n; ) {
+            if (!relayWait(f, f->out, POLLOUT)) goto out;
+            ssize_t w = write(f->out, buf + done, n - done);
+            if (w < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (w < 0) goto out;
+            done += w;
+        }
+    }
+out:
+    close(f->out);
+    f->out = -1;
+}
+
+void relayStop(PipeFile *f) {
+    if (!f->relay.joinable()) return;
+    char c = 0;
+    while (write(f->wake[1], &c, 1) < 0 && errno == EINTR) ;
+    f->relay.join();
+}
+
+void relayRelease(PipeFile *f) {
+    relayStop(f);
+    close(f->src);
+    close(f->wake[0]);
+    close(f->wake[1]);
+    if (f->raw) close(f->fd);
+}
+
+sf_count_t pipeLength(void *) {
+    // unknown: as far as libsndfile can tell, the data never ends
+    return (sf_count_t)1 << 60;
+}
+
+sf_count_t pipeRead(void *ptr, sf_count_t count, void *user) {
+    PipeFile *f = (PipeFile *)user;
+    sf_count_t done = 0;
+    while (done < count) {
+        ssize_t n = read(f->fd, (char *)ptr + done, count - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    f->pos += done;
+    return done;
+}
+
+sf_count_t pipeSeek(sf_count_t offset, int whence, void *user) {
+    PipeFile *f = (PipeFile *)user;
+    sf_count_t to = whence == SEEK_SET ? offset : whence == SEEK_CUR ? f->pos + offset : -1;
+    if (to < f->pos) return -1;
+    char skip[4096];
+    while (f->pos < to) {
+        sf_count_t want = to - f->pos < (sf_count_t)sizeof(skip) ? to - f->pos : sizeof(skip);
+        if (pipeRead(skip, want, user) < want) return -1;
+    }
+    return f->pos;
+}
+
+sf_count_t pipeWrite(const void *, sf_count_t, void *) {
+    return 0;
+}
+
+sf_count_t pipeTell(void *user) {
+    return ((PipeFile *)user)->pos;
+}
+
+}
+
+SNDFILE *pmPipeOpen(const std::string &path, const SF_INFO &raw, SF_INFO *info) {
+    std::unique_ptr<PipeFile> f(new PipeFile);
+    f->src = path == "-" ? dup(STDIN_FILENO) : open(path.c_str(), O_RDONLY);
+    if (f->src < 0) return NULL;
+    int p[2];
+    if (pipe(f->wake) < 0) {
+        close(f->src);
+        return NULL;
+    }
+    if (pipe(p) < 0) {
+        close(f->src);
+        close(f->wake[0]);
+        close(f->wake[1]);
+        return NULL;
+    }
+    // only the relay writes, and it must not block where it cannot be woken
+    fcntl(p[1], F_SETFL, fcntl(p[1], F_GETFL) | O_NONBLOCK);
+    f->fd = p[0];
+    f->out = p[1];
+    f->raw = raw.format != 0;
+    f->pos = 0;
+    f->relay = std::thread(relayRun, f.get());
+    SNDFILE *sndf;
+    if (!f->raw) {
+        // libsndfile reads a header from a pipe by itself
+        memset(info, 0, sizeof(*info));
+        sndf = sf_open_fd(f->fd, SFM_READ, info, SF_TRUE);
+        if (sndf == NULL) f->raw = true;        // still ours to close
+    } else {
+        static SF_VIRTUAL_IO vio = { pipeLength, pipeSeek, pipeRead, pipeWrite, pipeTell };
+        *info = raw;
+        sndf = sf_open_virtual(&vio, SFM_READ, info, f.get());
+    }
+    if (sndf == NULL) {
+        relayRelease(f.get());
+        return NULL;
+    }
+    f->sndf = sndf;
+    pipeFiles.push_back(std::move(f));
+    info->frames = SF_COUNT_MAX;
+    return sndf;
+}
+
+void pmPipeStop(SNDFILE *sndf) {
+    for (size_t i = 0; i < pipeFiles.size(); i++) {
+        if (pipeFiles[i]->sndf == sndf) relayStop(pipeFiles[i].get());
+    }
+}
+
+void pmPipeClose(SNDFILE *sndf) {
+    for (size_t i = 0; i < pipeFiles.size(); i++) {
+        if (pipeFiles[i]->sndf == sndf) {
+            // the writer sees EPIPE from here on
+            relayRelease(pipeFiles[i].get());
+            pipeFiles.erase(pipeFiles.begin() + i);
+            return;
+        }
+    }
+}
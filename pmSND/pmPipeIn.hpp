@@ -0,0 +1,64 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPipeIn.hpp
+* Streaming audio input: "-" (stdin) or a fifo instead of a sound file,
+* so an upstream decoder can pipe straight into the renderer rather than
+* writing a temporary WAV first.
+*
+* A stream with a header libsndfile can read sequentially (WAV, AU, ...)
+* is opened as is. Headerless PCM needs its format declared with
+* -r RATE:CHANNELS:s16|f32 and is read through virtual I/O that only ever
+* moves forward. Either way the length is unknown (frames is
+* SF_COUNT_MAX) and rendering starts with the first block. A relay
+* thread feeds libsndfile, so pmPipeStop() can end a read on a pipe
+* whose writer has gone quiet without closing it.
+*
+*/
+
+
+#ifndef pmPipeIn_hpp
+#define pmPipeIn_hpp
+
+#include <string>
+#include <sndfile.h>
+
+// "-" or the path of a fifo.
+bool pmPipeName(const std::string &path);
+
+// Parse RATE:CHANNELS:s16|f32 into a raw little-endian format.
+bool pmRawFormat(const std::string &spec, SF_INFO *info, std::string &err);
+
+// Open a pipe; raw is the declared format, or format 0 for a stream
+// with a header. info receives the format actually read.
+SNDFILE *pmPipeOpen(const std::string &path, const SF_INFO &raw, SF_INFO *info);
+
+// End the stream early: a read waiting on an idle pipe returns, as at
+// the end of the data. Call before joining a thread reading sndf.
+// Nothing to do for other files.
+void pmPipeStop(SNDFILE *sndf);
+
+// After sf_close(sndf): let go of what pmPipeOpen() set up for it.
+// Nothing to do for other files.
+void pmPipeClose(SNDFILE *sndf);
+
+#endif /* pmPipeIn_hpp */
@@ -0,0 +1,143 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPlayback.cpp
+*
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "pmPlayback.hpp"
+#include "pmTrace.hpp"
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+pmPlayback::pmPlayback() : quit(false) {
+    pcm = NULL;
+    audio = NULL;
+    period = 0;
+    framesize = 0;
+    rate = 0;
+    realtime = false;
+    running = false;
+    clockpos = 0;
+    clockns = 0;
+    written = xruns = 0;
+}
+
+pmPlayback::~pmPlayback() {
+    stop(true);
+}
+
+void pmPlayback::start(snd_pcm_t *_pcm, pmAudioReader *_audio, snd_pcm_uframes_t _period,
+                       int _framesize, unsigned int _rate) {
+    pcm = _pcm;
+    audio = _audio;
+    period = _period > 0 ? _period : 1024;
+    framesize = _framesize;
+    rate = _rate;
+    quit = false;
+    player = std::thread(&pmPlayback::run, this);
+}
+
+void pmPlayback::stop(bool drop) {
+    if (!player.joinable()) return;
+    if (drop) quit = true;
+    player.join();
+    if (drop) snd_pcm_drop(pcm);
+    else snd_pcm_drain(pcm);
+    std::lock_guard<std::mutex> g(lock);
+    running = false;
+}
+
+void pmPlayback::sampleClock() {
+    snd_pcm_status_t *status;
+    snd_pcm_status_alloca(&status);
+    if (snd_pcm_status(pcm, status) < 0) return;
+    std::lock_guard<std::mutex> g(lock);
+    running = snd_pcm_status_get_state(status) == SND_PCM_STATE_RUNNING;
+    clockpos = (long long)written - snd_pcm_status_get_delay(status);
+    clockns = nowns();
+}
+
+bool pmPlayback::position(double &frames) const {
+    std::lock_guard<std::mutex> g(lock);
+    if (!running) return false;
+    frames = clockpos + (nowns() - clockns) * (double)rate / 1e9;
+    // never past what the device has been given
+    if (frames > written) frames = written;
+    return true;
+}
+
+void pmPlayback::run() {
+    // A stall here is an audible click, a stall in the renderer only a
+    // late frame, so this thread asks for real-time scheduling.
+    struct sched_param sp;
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0;
+    pmTrace::nameThread("playback");
+
+    snd_pcm_nonblock(pcm, 0);
+    while (!quit) {
+        int nframes;
+        const unsigned char *blk = (const unsigned char *)audio->front(nframes, 1);
+        if (blk == NULL) break;
+        snd_pcm_sframes_t left = nframes;
+        while (left > 0 && !quit) {
+            snd_pcm_uframes_t n = left > (snd_pcm_sframes_t)period ? period : left;
+            unsigned long long t0 = pmTrace::now();
+            snd_pcm_sframes_t rc = snd_pcm_writei(pcm, blk, n);
+            pmTrace::record(pmTrace::ALSA, t0, pmTrace::now());
+            if (rc == -EPIPE || rc == -ESTRPIPE || rc == -EINTR) {
+                if (rc == -EPIPE) xruns++;
+                snd_pcm_recover(pcm, rc, 1);
+                continue;
+            } else if (rc < 0) {
+                std::cerr << "ERROR. Can't write to PCM device. " << snd_strerror(rc) << std::endl;
+                std::lock_guard<std::mutex> g(lock);
+                running = false;    // no clock to follow from here on
+                quit = true;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> g(lock);
+                written += rc;
+            }
+            left -= rc;
+            blk += rc * framesize;
+            sampleClock();
+        }
+        audio->pop(1);
+    }
+}
+
+void pmPlayback::report(std::ostream &os) const {
+    os << "Playback: " << written << " frames written, " << xruns << " underruns, "
+       << (realtime ? "SCHED_FIFO" : "normal priority (no permission for SCHED_FIFO)") << std::endl;
+}
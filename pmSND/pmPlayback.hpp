@@ -0,0 +1,82 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPlayback.hpp
+* Live playback on its own real-time thread. It plays the prefetched
+* blocks through a second reader cursor and publishes the position the
+* device has actually reached, which the render loop follows as the
+* master clock.
+*
+*/
+
+
+#ifndef pmPlayback_hpp
+#define pmPlayback_hpp
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <iostream>
+#include <alsa/asoundlib.h>
+
+#include "pmAudio.hpp"
+
+class pmPlayback {
+public:
+    pmPlayback();
+    ~pmPlayback();
+
+    // Play reader 1 of audio on pcm. framesize is bytes per sample frame.
+    void start(snd_pcm_t *pcm, pmAudioReader *audio, snd_pcm_uframes_t period,
+               int framesize, unsigned int rate);
+    // Let the device play out what it holds, or cut it short with drop.
+    void stop(bool drop);
+
+    // Sample frames heard since start, extrapolated to now. False until
+    // the device is actually running.
+    bool position(double &frames) const;
+
+    void report(std::ostream &os) const;
+
+private:
+    snd_pcm_t *pcm;
+    pmAudioReader *audio;
+    snd_pcm_uframes_t period;
+    int framesize;
+    unsigned int rate;
+    std::thread player;
+    std::atomic<bool> quit;
+    bool realtime;
+
+    // last clock sample, taken by the player right after each write
+    mutable std::mutex lock;
+    bool running;
+    long long clockpos;
+    unsigned long long clockns;
+
+    unsigned long long written, xruns;
+
+    void run();
+    void sampleClock();
+};
+
+#endif /* pmPlayback_hpp */
@@ -0,0 +1,260 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPresetCatalog.cpp
+*
+*/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "pmPresetCatalog.hpp"
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void fnv(uint64_t &h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+}
+
+static bool hashFile(const std::string &path, uint64_t &h) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    h = 14695981039346656037ull;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) fnv(h, buf, n);
+    close(fd);
+    return n == 0;
+}
+
+static long long mtimeOf(const struct stat &st) {
+    return st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+}
+
+// the extensions libprojectM's own directory scan accepts
+static bool isPreset(const char *name) {
+    size_t len = strlen(name);
+    return (len > 5 && strcmp(name + len - 5, ".milk") == 0) ||
+           (len > 5 && strcmp(name + len - 5, ".prjm") == 0);
+}
+
+static bool mkdirs(const std::string &dir) {
+    for (size_t i = 1; i <= dir.size(); i++) {
+        if (i == dir.size() || dir[i] == '/') {
+            std::string d = dir.substr(0, i);
+            if (mkdir(d.c_str(), 0755) < 0 && errno != EEXIST) return false;
+        }
+    }
+    return true;
+}
+
+pmPresetCatalog::pmPresetCatalog() {
+    warm = false;
+    changed = 0;
+    loadms = 0;
+}
+
+std::string pmPresetCatalog::defaultDir() {
+    const char *home = getenv("HOME");
+    if (home == NULL || *home == '\0') return "";
+    return std::string(home) + "/.projectM/presetindex";
+}
+
+bool pmPresetCatalog::load(const std::string &dir, const std::string &indexdir, std::string &err) {
+    unsigned long long t0 = nowns();
+    entries.clear();
+    warm = false;
+    changed = 0;
+
+    struct stat st;
+    if (stat(dir.c_str(), &st) < 0 || !S_ISDIR(st.st_mode)) {
+        err = "cannot open preset directory " + dir;
+        return false;
+    }
+    long long dirmtime = mtimeOf(st);
+    if (!mkdirs(indexdir)) {
+        err = "cannot create " + indexdir;
+        return false;
+    }
+    uint64_t dh = 14695981039346656037ull;
+    fnv(dh, dir.data(), dir.size());
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)dh);
+    std::string indexPath = indexdir + "/" + hex + ".idx";
+
+    // header: format line, then the directory and its mtime when indexed
+    std::ifstream in(indexPath.c_str());
+    std::string line, idxdir;
+    long long idxmtime = -1;
+    if (std::getline(in, line) && line == "# pmPresetIndex 1" && std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string tag;
+        if (std::getline(ls, tag, '\t') && tag == "dir" && std::getline(ls, idxdir, '\t')) {
+            ls >> idxmtime;
+        }
+        while (idxdir == dir && std::getline(in, line)) {
+            std::istringstream es(line);
+            Entry e;
+            unsigned long long h;
+            if (!std::getline(es, e.name, '\t') || !(es >> e.mtime >> e.size >> std::hex >> h)) continue;
+            e.path = dir + "/" + e.name;
+            e.hash = h;
+            entries.push_back(e);
+        }
+    }
+    in.close();
+
+    if (idxdir == dir && idxmtime == dirmtime) {
+        // No preset added, removed or renamed since the index was written.
+        // Files edited in place keep their index entry until the directory
+        // itself changes; libprojectM reads them fresh either way.
+        warm = true;
+    } else {
+        if (!scan(dir, dirmtime, err)) return false;
+        std::string tmp = indexPath + "." + std::to_string(getpid());
+        std::ofstream out(tmp.c_str());
+        out << "# pmPresetIndex 1\n" << "dir\t" << dir << "\t" << dirmtime << "\n";
+        char hbuf[17];
+        for (size_t i = 0; i < entries.size(); i++) {
+            snprintf(hbuf, sizeof(hbuf), "%016llx", (unsigned long long)entries[i].hash);
+            out << entries[i].name << "\t" << entries[i].mtime << " " << entries[i].size << " " << hbuf << "\n";
+        }
+        out.close();
+        if (!out || rename(tmp.c_str(), indexPath.c_str()) < 0) {
+            // still usable for this run, just not cached
+            unlink(tmp.c_str());
+            std::cerr << "cannot write preset index " << indexPath << std::endl;
+        }
+    }
+    rebuildMap();
+    loadms = (nowns() - t0) / 1e6;
+    return true;
+}
+
+bool pmPresetCatalog::scan(const std::string &dir, long long dirmtime, std::string &err) {
+    std::unordered_map<std::string, Entry> old;
+    for (size_t i = 0; i < entries.size(); i++) old[entries[i].name] = entries[i];
+    entries.clear();
+
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL) {
+        err = "cannot open preset directory " + dir + ": " + strerror(errno);
+        return false;
+    }
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (!isPreset(de->d_name)) continue;
+        Entry e;
+        e.name = de->d_name;
+        e.path = dir + "/" + e.name;
+        struct stat st;
+        if (stat(e.path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) continue;
+        e.mtime = mtimeOf(st);
+        e.size = st.st_size;
+        std::unordered_map<std::string, Entry>::iterator o = old.find(e.name);
+        if (o != old.end() && o->second.mtime == e.mtime && o->second.size == e.size) {
+            e.hash = o->second.hash;
+            old.erase(o);
+        } else {
+            if (!hashFile(e.path, e.hash)) continue;
+            if (o != old.end()) old.erase(o);
+            changed++;
+        }
+        entries.push_back(e);
+    }
+    closedir(d);
+    changed += old.size();      // presets that went away
+
+    // the order libprojectM's scan would give them
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.name < b.name; });
+    return true;
+}
+
+void pmPresetCatalog::adopt(const std::vector<std::string> &names) {
+    entries.clear();
+    for (size_t i = 0; i < names.size(); i++) {
+        Entry e;
+        e.name = names[i];
+        e.mtime = e.size = 0;
+        e.hash = 0;
+        entries.push_back(e);
+    }
+    rebuildMap();
+}
+
+void pmPresetCatalog::rebuildMap() {
+    byName.clear();
+    byName.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) byName[entries[i].name] = i;
+}
+
+std::vector<int> pmPresetCatalog::find(const std::string &spec) const {
+    std::vector<int> found;
+    if (spec.empty()) return found;
+    std::unordered_map<std::string, int>::const_iterator it = byName.find(spec);
+    if (it != byName.end()) {
+        found.push_back(it->second);
+        return found;
+    }
+    bool glob = spec.find_first_of("*?[") != std::string::npos;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const std::string &n = entries[i].name;
+        if (glob ? fnmatch(spec.c_str(), n.c_str(), 0) == 0 : n.compare(0, spec.size(), spec) == 0) {
+            found.push_back(i);
+        }
+    }
+    return found;
+}
+
+void pmPresetCatalog::restrict(const std::vector<int> &keep) {
+    std::vector<Entry> kept;
+    for (size_t i = 0; i < keep.size(); i++) kept.push_back(entries[keep[i]]);
+    entries.swap(kept);
+    rebuildMap();
+}
+
+void pmPresetCatalog::report(std::ostream &os) const {
+    os << "Preset catalog: " << entries.size() << " presets, " << (warm ? "warm" : "cold")
+       << " index";
+    if (!warm) os << " (" << changed << " changed)";
+    os << ", " << loadms << " ms" << std::endl;
+}
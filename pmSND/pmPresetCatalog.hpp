@@ -0,0 +1,83 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmPresetCatalog.hpp
+* Persistent preset index. Instead of letting libprojectM scan the preset
+* directory on every start, the list of presets (name, mtime, size and a
+* content hash) is kept in an index file that is only brought up to date
+* when the directory has changed, and the playlist is filled from it with
+* addPresetURL. Lookups by name go through a hash map.
+*
+*/
+
+
+#ifndef pmPresetCatalog_hpp
+#define pmPresetCatalog_hpp
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <stdint.h>
+
+class pmPresetCatalog {
+public:
+    struct Entry {
+        std::string name;
+        std::string path;
+        long long mtime;        // ns
+        long long size;
+        uint64_t hash;          // FNV-1a of the contents
+    };
+
+    pmPresetCatalog();
+
+    // Read the index of dir kept in indexdir, revalidate it against the
+    // directory and write it back if anything changed.
+    bool load(const std::string &dir, const std::string &indexdir, std::string &err);
+    // Catalog built from names libprojectM already has (no index).
+    void adopt(const std::vector<std::string> &names);
+
+    // Presets matching spec: the exact name if there is one, otherwise
+    // all names matching it as a glob (*?[) or as a prefix.
+    std::vector<int> find(const std::string &spec) const;
+    // Keep only these entries, in this order.
+    void restrict(const std::vector<int> &keep);
+
+    // ~/.projectM/presetindex, or empty if there is no home directory.
+    static std::string defaultDir();
+
+    void report(std::ostream &os) const;
+
+    std::vector<Entry> entries;
+    bool warm;                  // index was usable as it was
+    int changed;                // entries rehashed or dropped
+    double loadms;
+
+private:
+    std::unordered_map<std::string, int> byName;
+
+    void rebuildMap();
+    bool scan(const std::string &dir, long long dirmtime, std::string &err);
+};
+
+#endif /* pmPresetCatalog_hpp */
@@ -0,0 +1,165 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmReadback.cpp
+*
+*/
+
+#include <time.h>
+
+#include "pmReadback.hpp"
+#include "pmGpuTimer.hpp"
+
+static unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+pmReadback::pmReadback() {
+    width = height = bufsz = 0;
+    format = GL_BGRA;
+    head = tail = pending = 0;
+    mapped = false;
+    failed = false;
+}
+
+pmReadback::~pmReadback() {
+    destroy();
+}
+
+void pmReadback::init(int w, int h, int depth, GLenum fmt) {
+    width = w;
+    height = h;
+    format = fmt;
+    bufsz = sizeof( GLubyte ) * width * height * (format == GL_RED ? 1 : 4);
+    if (depth < 2) depth = 2;
+
+    slots.resize(depth);
+    for (Slot &s : slots) {
+        glGenBuffers(1, &s.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bufsz, 0, GL_STREAM_READ);
+        s.fence = 0;
+        s.frames = s.stalls = s.stallns = s.maxstallns = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    head = tail = pending = 0;
+    failed = false;
+}
+
+void pmReadback::destroy() {
+    for (Slot &s : slots) {
+        if (s.fence) glDeleteSync(s.fence);
+        glDeleteBuffers(1, &s.pbo);
+    }
+    slots.clear();
+}
+
+// Wait for the slot's fence. Without block only polls; a blocking wait
+// that actually has to sleep is what we call a stall.
+bool pmReadback::waitSlot(Slot &s, bool block) {
+    if (s.fence == 0) return true;
+    GLenum rc = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (rc == GL_TIMEOUT_EXPIRED && block) {
+        unsigned long long t0 = nowns();
+        do {
+            rc = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        } while (rc == GL_TIMEOUT_EXPIRED);
+        unsigned long long dt = nowns() - t0;
+        s.stalls++;
+        s.stallns += dt;
+        if (dt > s.maxstallns) s.maxstallns = dt;
+    }
+    if (rc == GL_TIMEOUT_EXPIRED) return false;
+    if (rc == GL_WAIT_FAILED) {
+        std::cerr << "readback fence wait failed" << std::endl;
+    }
+    glDeleteSync(s.fence);
+    s.fence = 0;
+    return true;
+}
+
+void pmReadback::capture(GLuint fbo) {
+    // The ring is full of frames nobody collected: the oldest one has
+    // to be dropped, which should never happen if acquire() is called
+    // once per capture().
+    if (pending == slots.size()) {
+        std::cerr << "readback ring overrun, dropping a frame" << std::endl;
+        waitSlot(slots[tail], true);
+        tail = (tail + 1) % slots.size();
+        pending--;
+    }
+
+    Slot &s = slots[head];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+    pmGpuTimer::begin(pmTrace::GPU_READBACK);
+    glReadPixels(0, 0, width, height, format, GL_UNSIGNED_BYTE, 0);
+    pmGpuTimer::end();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush(); // get the read going before we look at older slots
+    s.frames++;
+
+    head = (head + 1) % slots.size();
+    pending++;
+}
+
+const GLubyte *pmReadback::acquire(bool wait) {
+    if (pending == 0) return NULL;
+    Slot &s = slots[tail];
+    // Leave the newest frames in flight as long as there is room for
+    // them; only a full ring forces us to wait on the oldest.
+    if (!waitSlot(s, wait || pending == slots.size())) return NULL;
+    const GLubyte *ptr = (const GLubyte *)glMapNamedBuffer(s.pbo, GL_READ_ONLY);
+    if (ptr == NULL) {
+        // give the slot back rather than leave the ring stuck on it
+        std::cerr << "readback: cannot map frame buffer, GL error " << glGetError() << std::endl;
+        failed = true;
+        tail = (tail + 1) % slots.size();
+        pending--;
+        return NULL;
+    }
+    mapped = true;
+    return ptr;
+}
+
+void pmReadback::release() {
+    if (!mapped) return;
+    glUnmapNamedBuffer(slots[tail].pbo);
+    mapped = false;
+    tail = (tail + 1) % slots.size();
+    pending--;
+}
+
+void pmReadback::report(std::ostream &os) const {
+    os << "Readback ring: " << slots.size() << " slots, " << width << "x" << height << std::endl;
+    for (size_t i = 0; i < slots.size(); i++) {
+        const Slot &s = slots[i];
+        os << "  slot " << i << ": frames " << s.frames << ", stalls " << s.stalls
+           << ", stall time " << s.stallns / 1000000.0 << " ms"
+           << ", max stall " << s.maxstallns / 1000000.0 << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,84 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmReadback.hpp
+* Asynchronous frame readback: a ring of pixel pack buffers, each guarded
+* by a fence so that a buffer is mapped only once the GPU has filled it.
+*
+*/
+
+
+#ifndef pmReadback_hpp
+#define pmReadback_hpp
+
+#include <vector>
+#include <iostream>
+
+#include "projectM-opengl.h"
+
+class pmReadback {
+public:
+    pmReadback();
+    ~pmReadback();
+
+    // format is GL_BGRA for packed frames or GL_RED for frames already
+    // converted to planar YUV on the GPU (height then counts all planes).
+    void init(int width, int height, int depth, GLenum format = GL_BGRA);
+    void destroy();
+
+    // Queue a read of framebuffer fbo into the next free slot.
+    void capture(GLuint fbo = 0);
+
+    // Map the oldest captured frame if the GPU is done with it. Returns NULL
+    // when nothing is ready yet; with wait set, blocks for the oldest frame
+    // and returns NULL only if the ring is empty. A frame that cannot be
+    // mapped is dropped and sets failed, NULL being returned as well.
+    const GLubyte *acquire(bool wait = false);
+    void release();
+
+    void report(std::ostream &os) const;
+
+    int width, height;
+    GLenum format;
+    int bufsz;
+    bool failed;            // glMapNamedBuffer failed
+
+private:
+    struct Slot {
+        GLuint pbo;
+        GLsync fence;
+        unsigned long long frames;
+        unsigned long long stalls;
+        unsigned long long stallns;
+        unsigned long long maxstallns;
+    };
+
+    std::vector<Slot> slots;
+    unsigned int head;      // next slot to capture into
+    unsigned int tail;      // oldest captured slot
+    unsigned int pending;   // captured but not yet released
+    bool mapped;
+
+    bool waitSlot(Slot &s, bool block);
+};
+
+#endif /* pmReadback_hpp */
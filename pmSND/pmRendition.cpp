@@ -0,0 +1,404 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmRendition.cpp
+*
+*/
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "pmRendition.hpp"
+#include "pmTrace.hpp"
+
+bool parseRenditions(const std::string &arg, std::vector<pmRenditionSpec> &specs, std::string &err) {
+    size_t start = 0;
+    while (start <= arg.size()) {
+        size_t end = arg.find(',', start);
+        if (end == std::string::npos) end = arg.size();
+        std::string item = arg.substr(start, end - start);
+        start = end + 1;
+
+        pmRenditionSpec spec;
+        spec.width = spec.height = 0;
+        size_t at = item.find('@');
+        spec.path = item.substr(0, at);
+        while (at != std::string::npos) {
+            size_t next = item.find('@', at + 1);
+            std::string field = item.substr(at + 1, next == std::string::npos ? std::string::npos : next - at - 1);
+            at = next;
+            int w, h;
+            char tail;
+            if (sscanf(field.c_str(), "%dx%d%c", &w, &h, &tail) == 2) {
+                if (w <= 0 || h <= 0 || spec.width > 0) {
+                    err = "-v " + item + ": bad size " + field;
+                    return false;
+                }
+                spec.width = w;
+                spec.height = h;
+            } else if (!field.empty() && spec.codec.empty()) {
+                spec.codec = field;
+            } else {
+                err = "-v " + item + ": expected path[@WxH][@codec]";
+                return false;
+            }
+        }
+        if (spec.path.empty()) {
+            err = "-v " + arg + ": empty output name";
+            return false;
+        }
+        for (size_t i = 0; i < specs.size(); i++) {
+            if (specs[i].path == spec.path) {
+                err = "-v: " + spec.path + " given twice";
+                return false;
+            }
+        }
+        specs.push_back(spec);
+    }
+    return true;
+}
+
+pmRendition::pmRendition() {
+    width = height = srcwidth = srcheight = 0;
+    frames = bytes = 0;
+    scaling = converting = false;
+    framesz = smplsize = 0;
+    vfd = afd = -1;
+    pid = -1;
+    failed = false;
+#ifdef HAVE_LIBAV
+    avenc = NULL;
+#endif
+}
+
+pmRendition::~pmRendition() {
+#ifdef HAVE_LIBAV
+    delete avenc;
+#endif
+    if (vfd >= 0) close(vfd);
+    if (afd >= 0) close(afd);
+}
+
+bool pmRendition::open(const pmRenditionSpec &spec, int _srcwidth, int _srcheight,
+                       const pmEncodeParams &_params, std::string &err) {
+    params = _params;
+    path = spec.path;
+    codec = spec.codec.empty() ? params.vcodec : spec.codec;
+    srcwidth = _srcwidth;
+    srcheight = _srcheight;
+    width = spec.width > 0 ? spec.width : params.outwidth > 0 ? params.outwidth : srcwidth;
+    height = spec.width > 0 ? spec.height : params.outwidth > 0 ? params.outheight : srcheight;
+
+    // The video may have a size of its own; it is scaled on the GPU
+    // between rendering and readback.
+    scaling = width != srcwidth || height != srcheight;
+    if (scaling) {
+        scaler.init(srcwidth, srcheight, width, height);
+        std::cout << path << ": video size " << width << "x" << height
+                  << " (rendered at " << srcwidth << "x" << srcheight << ")" << std::endl;
+    }
+
+    // With GPU conversion the frame is cropped to even dimensions and read
+    // back as one W x 3H/2 byte plane set instead of W x H BGRA.
+    converting = !params.gpuPixFmt.empty();
+    if (converting) {
+        width &= ~1;
+        height &= ~1;
+        yuv.init(params.gpuPixFmt == "nv12", width, height);
+        readback.init(width, height * 3 / 2, params.rbdepth, GL_RED);
+    } else {
+        readback.init(width, height, params.rbdepth);
+    }
+    framesz = readback.bufsz;
+    smplsize = params.floatpcm ? sizeof(float) : sizeof(short);
+
+    if (params.encoder == "lavc") {
+#ifdef HAVE_LIBAV
+        avenc = new pmAVEncoder();
+        std::string averr;
+        if (!avenc->open(path, codec, params.encthreads, width, height, params.fps,
+                         converting ? params.gpuPixFmt : "bgra",
+                         params.videoonly ? 0 : params.samplerate, params.channels, averr)) {
+            err = "cannot start in-process encoder: " + averr;
+            return false;
+        }
+        silence.assign(params.asamples * params.channels, 0); // zero bits for s16 too
+        return true;
+#else
+        err = "-e lavc: built without libavcodec, rebuild with make LIBAV=1";
+        return false;
+#endif
+    }
+    return spawnFFmpeg(err);
+}
+
+bool pmRendition::spawnFFmpeg(std::string &err) {
+    int ffmpipe[2] = {-1, -1};
+    int audpipe[2] = {-1, -1};
+    if (pipe(ffmpipe) == -1) {
+        err = std::string("ffmpeg video pipe creation error ") + strerror(errno);
+        return false;
+    }
+    // segments are video only, the audio is added when they are stitched
+    if (!params.videoonly && pipe(audpipe) == -1) {
+        err = std::string("ffmpeg audio pipe creation error ") + strerror(errno);
+        return false;
+    }
+    if (params.seglen > 0) {
+        if (!stream.start(path, params.seglen, params.fps, err)) {
+            return false;
+        }
+        std::cout << "Streaming " << params.seglen << " s segments to " << pmStreamWatch::playlist(path) << std::endl;
+    }
+    // a rendition started earlier must not see our pipes held open, nor
+    // must we keep its: every write end is close-on-exec
+    fcntl(ffmpipe[1], F_SETFD, FD_CLOEXEC);
+    if (audpipe[1] >= 0) fcntl(audpipe[1], F_SETFD, FD_CLOEXEC);
+    // Everything the child needs is built here: after fork() only
+    // async-signal-safe calls are allowed, and the decoder and earlier
+    // writer threads may be holding the malloc lock.
+    const char *pixfmt = converting ? params.gpuPixFmt.c_str() : "bgra";
+    char fmtbuf[50];
+    snprintf(fmtbuf, 49, "%dx%d", width, height);
+    char fpsbuf[10];
+    snprintf(fpsbuf, 9, "%d", params.fps);
+    char pipebuf[20];
+    snprintf(pipebuf, 19, "pipe:%d", ffmpipe[0]);
+    // the audio is the PCM we visualize, padding included, so it
+    // lines up with the frames sample for sample
+    char apipebuf[20];
+    snprintf(apipebuf, 19, "pipe:%d", audpipe[0]);
+    char ratebuf[20];
+    snprintf(ratebuf, 19, "%d", params.samplerate);
+    char chbuf[10];
+    snprintf(chbuf, 9, "%d", params.channels);
+    const char *ffmargs[] = { "ffmpeg", "-y", "-thread_queue_size", "64", "-video_size", fmtbuf, "-framerate", fpsbuf,
+                        "-f", "rawvideo", "-pix_fmt", pixfmt, "-s", fmtbuf,
+                        "-i", pipebuf,
+                        "-thread_queue_size", "1024",
+                        "-f", params.floatpcm ? "f32le" : "s16le", "-ar", ratebuf, "-ac", chbuf,
+                        "-i", apipebuf,
+                        "-vcodec", codec.c_str(), "-pix_fmt", "yuv420p",
+                        "-acodec", "aac", "-y", path.c_str(),
+                        NULL};
+    // a segment is video only, the audio is added when they are stitched
+    const char *segargs[] = { "ffmpeg", "-y", "-video_size", fmtbuf, "-framerate", fpsbuf,
+                        "-f", "rawvideo", "-pix_fmt", pixfmt, "-s", fmtbuf,
+                        "-i", pipebuf,
+                        "-vcodec", codec.c_str(), "-pix_fmt", "yuv420p",
+                        "-y", path.c_str(),
+                        NULL};
+    // streaming: HLS in fMP4 segments, a keyframe starting each one;
+    // ffmpeg renames a segment into place once it is complete
+    char seglenbuf[20];
+    snprintf(seglenbuf, 19, "%g", params.seglen);
+    std::string keyframes = std::string("expr:gte(t,n_forced*") + seglenbuf + ")";
+    std::string segfiles = pmStreamWatch::segmentPattern(path);
+    std::string playlist = pmStreamWatch::playlist(path);
+    // the lossless default cannot go into MP4 segments
+    const char *streamcodec = codec == "ffvhuff" ? "libx264" : codec.c_str();
+    std::vector<const char *> streamargs;     // the same inputs
+    for (const char **a = ffmargs; strcmp(*a, "-vcodec") != 0; a++) {
+        streamargs.push_back(*a);
+    }
+    const char *hlsargs[] = { "-vcodec", streamcodec, "-pix_fmt", "yuv420p",
+                        "-force_key_frames", keyframes.c_str(), "-acodec", "aac",
+                        "-f", "hls", "-hls_time", seglenbuf, "-hls_list_size", "0",
+                        "-hls_playlist_type", "event", "-hls_segment_type", "fmp4",
+                        "-hls_flags", "independent_segments+temp_file",
+                        "-hls_segment_filename", segfiles.c_str(), playlist.c_str() };
+    streamargs.insert(streamargs.end(), hlsargs, hlsargs + sizeof(hlsargs) / sizeof(hlsargs[0]));
+    if (strcmp(streamcodec, "libx264") == 0) {
+        // no lookahead: a segment is ready as soon as its frames are
+        const char *x264args[] = { "-preset", "veryfast", "-tune", "zerolatency" };
+        streamargs.insert(streamargs.end() - 1, x264args, x264args + 4);
+    }
+    streamargs.push_back(NULL);
+    char *const *argv = (char *const *)(params.videoonly ? segargs : params.seglen > 0 ? streamargs.data() : ffmargs);
+
+    pid = fork();
+    if (pid < 0) {
+        err = std::string("ffmpeg process creation error ") + strerror(errno);
+        return false;
+    } else if (pid == 0) {
+        close(ffmpipe[1]); // or ffmpeg never sees EOF on its input
+        if (audpipe[1] >= 0) close(audpipe[1]);
+        execvp("ffmpeg", argv);
+        static const char msg[] = "ffmpeg process exec error\n";
+        if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) {}
+        _exit(EXIT_FAILURE);
+    }
+    close(ffmpipe[0]);
+    vfd = ffmpipe[1];
+    // a dead ffmpeg should show up as EPIPE in the writer, not kill us
+    signal(SIGPIPE, SIG_IGN);
+    videoq.start(vfd, framesz, params.queuelen, params.usesplice);
+    if (audpipe[1] >= 0) {
+        close(audpipe[0]);
+        afd = audpipe[1];
+        // ffmpeg may take a while to get to its second input: a couple
+        // of seconds of blocks keep the render loop from waiting on it
+        audioq.start(afd, (size_t)params.asamples * params.channels * smplsize, 2 * params.fps, params.usesplice);
+    }
+    return true;
+}
+
+bool pmRendition::frame() {
+    if (failed) return false;
+    GLuint src = 0;
+    if (scaling) {
+        PM_TRACE(SCALE);
+        src = scaler.scale();
+    }
+    if (converting) {
+        PM_TRACE(YUV);
+        src = yuv.convert(src);
+    }
+    unsigned long long t0 = pmTrace::now();
+    readback.capture(src);
+    unsigned long long t1 = pmTrace::now();
+    const GLubyte *ptr = readback.acquire();
+    pmTrace::record(pmTrace::CAPTURE, t0, t1);
+    pmTrace::record(pmTrace::MAP, t1, pmTrace::now());
+    if (ptr == NULL) {
+        // not ready yet, or the GPU frame is lost: that fails the output
+        if (readback.failed) failed = true;
+        return !failed;
+    }
+    unsigned long long t2 = pmTrace::now();
+    bool sent = send(ptr);
+    pmTrace::record(pmTrace::SEND, t2, pmTrace::now());
+    readback.release();
+    return sent;
+}
+
+// Copy the mapped frame into a pooled buffer so the PBO goes back to
+// the GPU right away; the writer thread feeds it to ffmpeg. The
+// in-process encoder takes it straight from the mapping instead.
+bool pmRendition::send(const unsigned char *ptr) {
+    bytes += framesz;
+    if (params.seglen > 0) stream.frameSent(frames);
+    frames++;
+#ifdef HAVE_LIBAV
+    if (avenc != NULL) {
+        if (!avenc->addVideo(ptr)) failed = true;
+        return !failed;
+    }
+#endif
+    unsigned char *buf = videoq.acquire();
+    if (buf == NULL) {
+        close(vfd);
+        vfd = -1;
+        failed = true;
+        return false;
+    }
+    memcpy(buf, ptr, framesz);
+    videoq.push(buf, framesz);
+    return true;
+}
+
+// The encoder gets the very PCM we visualize, silence for the -b/-a
+// padding, so no second decode and no resync is needed.
+bool pmRendition::audio(const void *pcm, int nframes) {
+    if (failed) return false;
+#ifdef HAVE_LIBAV
+    if (avenc != NULL) {
+        if (params.videoonly) return true;
+        if (pcm == NULL) pcm = silence.data();
+        bool ok = params.floatpcm ? avenc->addAudio((const float *)pcm, nframes)
+                                  : avenc->addAudio((const short *)pcm, nframes);
+        // an audio encode or mux error fails the output like a video one
+        if (!ok) failed = true;
+        return ok;
+    }
+#endif
+    if (afd < 0) return true;
+    unsigned char *buf = audioq.acquire();
+    if (buf == NULL) return true;   // ffmpeg is gone; the video side stops the export
+    size_t len = (size_t)nframes * params.channels * smplsize;
+    if (pcm != NULL) {
+        memcpy(buf, pcm, len);
+    } else {
+        memset(buf, 0, len);
+    }
+    audioq.push(buf, len);
+    return true;
+}
+
+bool pmRendition::finish() {
+    // collect the frames still in flight in the readback ring
+    while (!failed) {
+        const GLubyte *ptr = readback.acquire(true);
+        if (ptr == NULL) {
+            if (readback.failed) failed = true;
+            break;
+        }
+        send(ptr);
+        readback.release();
+    }
+    videoq.finish();
+    audioq.finish();
+#ifdef HAVE_LIBAV
+    if (avenc != NULL && !avenc->close()) failed = true;
+#endif
+    if (vfd >= 0) close(vfd);
+    if (afd >= 0) close(afd);
+    vfd = afd = -1;
+    // the file (or the last stream segment) is complete only once ffmpeg
+    // has seen the end of its input and written the trailer
+    if (pid > 0) {
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << path << ": ffmpeg failed" << std::endl;
+            failed = true;
+        }
+        pid = -1;
+    }
+    if (params.seglen > 0) stream.stop();
+    readback.destroy();
+    if (converting) yuv.destroy();
+    if (scaling) scaler.destroy();
+    return !failed;
+}
+
+void pmRendition::report(std::ostream &os) const {
+    os << "Rendition " << path << ": " << width << "x" << height << " " << params.encoder << "/" << codec
+       << ", " << frames << " frames, " << bytes / 1048576 << " MiB read back" << std::endl;
+    readback.report(os);
+#ifdef HAVE_LIBAV
+    if (avenc != NULL) {
+        avenc->report(os);
+    } else
+#endif
+    {
+        videoq.report(os, "video");
+        if (!params.videoonly) audioq.report(os, "audio");
+    }
+    if (params.seglen > 0) stream.report(os);
+}
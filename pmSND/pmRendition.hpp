@@ -0,0 +1,125 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmRendition.hpp
+* Video outputs: one render feeds any number of renditions, each with its
+* own size and codec. Every rendition scales the rendered frame on the GPU
+* (pmScaler), optionally converts it to YUV (pmYUV) and has its own
+* readback ring and encoder (an ffmpeg child fed through pmFrameQueues,
+* or pmAVEncoder in process), so N outputs cost one renderFrame().
+*
+* -v takes a comma separated list of path[@WxH][@codec], e.g.
+*     -v master.mkv,proxy.mp4@640x360@libx264
+*
+*/
+
+
+#ifndef pmRendition_hpp
+#define pmRendition_hpp
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/types.h>
+
+#include "pmReadback.hpp"
+#include "pmFrameQueue.hpp"
+#include "pmScaler.hpp"
+#include "pmYUV.hpp"
+#include "pmStream.hpp"
+#ifdef HAVE_LIBAV
+#include "pmAVEncoder.hpp"
+#endif
+
+struct pmRenditionSpec {
+    std::string path;
+    int width, height;      // 0: the -G size, else the render size
+    std::string codec;      // empty: -c
+};
+
+bool parseRenditions(const std::string &arg, std::vector<pmRenditionSpec> &specs, std::string &err);
+
+// What every rendition of a job shares.
+struct pmEncodeParams {
+    std::string encoder;    // ffmpeg or lavc
+    std::string vcodec;     // default codec
+    std::string gpuPixFmt;  // empty for BGRA readback, or yuv420p / nv12
+    int outwidth, outheight;
+    int encthreads, rbdepth, queuelen;
+    bool usesplice;
+    int fps;
+    int samplerate, channels;
+    bool floatpcm;
+    int asamples;           // sample frames per video frame
+    bool videoonly;         // a -j segment: the audio is added when stitching
+    double seglen;          // -S: stream HLS segments into a directory
+};
+
+class pmRendition {
+public:
+    pmRendition();
+    ~pmRendition();
+
+    // srcwidth x srcheight is the render size.
+    bool open(const pmRenditionSpec &spec, int srcwidth, int srcheight,
+              const pmEncodeParams &params, std::string &err);
+
+    // Queue the readback of the frame just rendered and pass on the oldest
+    // frame the GPU is done with. False once the encoder has failed.
+    bool frame();
+    // The PCM of the frame, NULL for silence.
+    bool audio(const void *pcm, int nframes);
+    // Pass on the frames still in the readback ring, close the encoder
+    // and wait for it. False if anything went wrong with this output.
+    bool finish();
+
+    void report(std::ostream &os) const;
+
+    std::string path;
+    int width, height;
+    unsigned long long frames, bytes;
+
+private:
+    pmEncodeParams params;
+    std::string codec;
+    int srcwidth, srcheight;
+    bool scaling, converting;
+    pmScaler scaler;
+    pmYUV yuv;
+    pmReadback readback;
+    int framesz, smplsize;
+
+    int vfd, afd;
+    pid_t pid;
+    pmFrameQueue videoq, audioq;
+    pmStreamWatch stream;
+    bool failed;
+#ifdef HAVE_LIBAV
+    pmAVEncoder *avenc;
+    std::vector<float> silence;
+#endif
+
+    bool spawnFFmpeg(std::string &err);
+    bool send(const unsigned char *ptr);
+};
+
+#endif /* pmRendition_hpp */
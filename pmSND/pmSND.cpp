@@ -29,6 +29,8 @@
 */
 
 #include "pmSND.hpp"
+#include "pmTrace.hpp"
+#include "pmGpuTimer.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Renderer/ShaderEngine.hpp"
@@ -146,7 +148,38 @@ void projectMSND::keyHandler(SDL_Event *sdl_evt) {
 void projectMSND::resize(unsigned int width_, unsigned int height_) {
     width = width_;
     height = height_;
-    projectM_resetGL(width, height);
+    if (scaleFBO != 0) {
+        setRenderScale(renderScale);
+    } else {
+        projectM_resetGL(width, height);
+    }
+}
+
+void projectMSND::setRenderScale(float scale) {
+    if (renderToTexture) return;
+    if (scaleFBO != 0) {
+        glDeleteFramebuffers(1, &scaleFBO);
+        glDeleteTextures(1, &scaleTex);
+        scaleFBO = scaleTex = 0;
+    }
+    renderScale = scale < 1.0f ? scale : 1.0f;
+    renderWidth = width * renderScale;
+    renderHeight = height * renderScale;
+    if (renderWidth < 1) renderWidth = 1;
+    if (renderHeight < 1) renderHeight = 1;
+    if (renderScale < 1.0f) {
+        glGenTextures(1, &scaleTex);
+        glBindTexture(GL_TEXTURE_2D, scaleTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, renderWidth, renderHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenFramebuffers(1, &scaleFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, scaleFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scaleTex, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    projectM_resetGL(renderWidth, renderHeight);
 }
 
 void projectMSND::pollEvent() {
@@ -157,6 +190,9 @@ void projectMSND::pollEvent() {
     int mousey = 0;
     float mouseyscale = 0;
     int mousepressure = 0;
+    if (win == NULL) {
+        return;
+    }
     while (SDL_PollEvent(&evt))
     {
         switch (evt.type) {
@@ -204,17 +240,40 @@ void projectMSND::touchDestroyAll() {
     projectM::touchDestroyAll();
 }
 
-void projectMSND::renderFrame() {
+void projectMSND::renderFrame(bool present) {
     glClearColor( 0.0, 0.0, 0.0, 0.0 );
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    projectM::renderFrame();
+    {
+        PM_TRACE(RENDER);
+        PM_GPU_TRACE(GPU_RENDER);
+        projectM::renderFrame();
+    }
+
+    if (scaleFBO != 0) {
+        // the frame only covers the lower left corner: copy it out and
+        // stretch it over the whole window
+        PM_TRACE(SCALE);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaleFBO);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, scaleFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
 
     if (renderToTexture) {
+        PM_TRACE(TEXTURE);
+        PM_GPU_TRACE(GPU_TEXTURE);
         renderTexture();
     }
 
-    SDL_GL_SwapWindow(win);
+    // headless (offscreen) rendering has no window to present to
+    if (win != NULL && present) {
+        PM_TRACE(SWAP);
+        SDL_GL_SwapWindow(win);
+    }
 }
 
 projectMSND::projectMSND(Settings settings, int flags) : projectM(settings, flags) {
@@ -222,6 +281,7 @@ projectMSND::projectMSND(Settings settings, int flags) : projectM(settings, flag
     height = getWindowHeight();
     done = 0;
     isFullScreen = false;
+    win = NULL;
 }
 
 projectMSND::projectMSND(std::string config_file, int flags) : projectM(config_file, flags) {
@@ -229,6 +289,7 @@ projectMSND::projectMSND(std::string config_file, int flags) : projectM(config_f
     height = getWindowHeight();
     done = 0;
     isFullScreen = false;
+    win = NULL;
 }
 
 void projectMSND::init(SDL_Window *window, SDL_GLContext *_glCtx, const bool _renderToTexture) {
@@ -341,6 +402,8 @@ void projectMSND::presetSwitchedEvent(bool isHardCut, size_t index) const {
     std::string presetName = getPresetName(index);
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Displaying preset: %s\n", presetName.c_str());
     
-    std::string newTitle = "projectM ➫ " + presetName;
-    SDL_SetWindowTitle(win, newTitle.c_str());
+    if (win != NULL) {
+        std::string newTitle = "projectM ➫ " + presetName;
+        SDL_SetWindowTitle(win, newTitle.c_str());
+    }
 }
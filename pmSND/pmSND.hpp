@@ -31,9 +31,7 @@
 #define pmSND_hpp
 
 
-#define FAKE_AUDIO          0
 // ----------------------------
-#define TEST_ALL_PRESETS    0
 #define STEREOSCOPIC_SBS    0
 
 #include "projectM-opengl.h"
@@ -77,7 +75,11 @@ public:
     void touchDrag(float x, float y, int pressure);
     void touchDestroy(float x, float y);
     void touchDestroyAll();
-    void renderFrame();
+    // present = false renders (and advances the preset) without a swap
+    void renderFrame(bool present = true);
+    // Render at scale times the window size and stretch the frame to the
+    // window (live quality governor); 1 renders at full size again.
+    void setRenderScale(float scale);
     void pollEvent();
     void maximize();
     bool keymod = false;
@@ -105,6 +107,11 @@ private:
     GLuint m_vao = 0;
     GLuint textureID = 0;
 
+    // reduced render size, stretched to the window through scaleFBO
+    float renderScale = 1.0f;
+    unsigned int renderWidth = 0, renderHeight = 0;
+    GLuint scaleFBO = 0, scaleTex = 0;
+
     // audio input device characteristics
     unsigned int NumAudioDevices;
     unsigned int CurAudioDevice;
@@ -0,0 +1,97 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmScaler.cpp
+*
+*/
+
+#include <SDL2/SDL.h>
+
+#include "pmScaler.hpp"
+#include "pmGpuTimer.hpp"
+
+pmScaler::pmScaler() {
+    width = height = srcwidth = srcheight = 0;
+}
+
+pmScaler::~pmScaler() {
+    destroy();
+}
+
+void pmScaler::init(int _srcwidth, int _srcheight, int _width, int _height) {
+    destroy();
+    srcwidth = _srcwidth;
+    srcheight = _srcheight;
+    width = _width;
+    height = _height;
+
+    int w = srcwidth, h = srcheight;
+    while (w / 2 >= width && h / 2 >= height && (w > 2 * width || h > 2 * height)) {
+        w /= 2;
+        h /= 2;
+        levels.push_back(Level{0, 0, w, h});
+    }
+    levels.push_back(Level{0, 0, width, height});
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        Level &l = levels[i];
+        glGenTextures(1, &l.tex);
+        glBindTexture(GL_TEXTURE_2D, l.tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, l.w, l.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenFramebuffers(1, &l.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, l.fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, l.tex, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "scaling framebuffer %dx%d is incomplete\n", l.w, l.h);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void pmScaler::destroy() {
+    for (size_t i = 0; i < levels.size(); i++) {
+        glDeleteFramebuffers(1, &levels[i].fbo);
+        glDeleteTextures(1, &levels[i].tex);
+    }
+    levels.clear();
+}
+
+GLuint pmScaler::scale(GLuint src) {
+    PM_GPU_TRACE(GPU_SCALE);
+    GLuint from = src;
+    int w = srcwidth, h = srcheight;
+    for (size_t i = 0; i < levels.size(); i++) {
+        Level &l = levels[i];
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, from);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, l.fbo);
+        glBlitFramebuffer(0, 0, w, h, 0, 0, l.w, l.h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        from = l.fbo;
+        w = l.w;
+        h = l.h;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    return from;
+}
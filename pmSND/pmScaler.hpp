@@ -0,0 +1,63 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmScaler.hpp
+* Output scaling: the rendered frame is resized on the GPU to the encode
+* size (-G) before readback. Downscaling by more than 2x first halves the
+* frame through a chain of framebuffers, each a linear blit that averages
+* 2x2 pixels, so a supersampled render is filtered instead of decimated;
+* the last step is a linear blit to the exact size.
+*
+*/
+
+
+#ifndef pmScaler_hpp
+#define pmScaler_hpp
+
+#include <vector>
+
+#include "projectM-opengl.h"
+
+class pmScaler {
+public:
+    pmScaler();
+    ~pmScaler();
+
+    void init(int srcwidth, int srcheight, int width, int height);
+    void destroy();
+
+    // Scale framebuffer src; returns the framebuffer holding the frame at
+    // width x height.
+    GLuint scale(GLuint src = 0);
+
+    int width, height;
+
+private:
+    struct Level {
+        GLuint fbo, tex;
+        int w, h;
+    };
+    int srcwidth, srcheight;
+    std::vector<Level> levels;  // halving steps, then the output size
+};
+
+#endif /* pmScaler_hpp */
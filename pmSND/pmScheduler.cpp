@@ -0,0 +1,99 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmScheduler.cpp
+*
+*/
+
+#include <algorithm>
+#include <time.h>
+
+#include "pmScheduler.hpp"
+
+pmScheduler::pmScheduler() {
+    policy = LATE_SKIP;
+    period = next = 0;
+    frames = late = resyncs = maxns = 0;
+}
+
+unsigned long long pmScheduler::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void pmScheduler::start(int fps, Policy _policy) {
+    policy = _policy;
+    period = 1000000000ull / (fps > 0 ? fps : 60);
+    next = 0;
+    hist.assign(NBUCKETS + 1, 0);
+}
+
+pmScheduler::Action pmScheduler::wait() {
+    unsigned long long t = now();
+    // After a stall of more than a second (or on the first frame) start a
+    // new grid instead of rushing through all the missed deadlines.
+    if (next == 0 || t > next + 1000000000ull) {
+        if (next != 0) resyncs++;
+        next = t;
+    }
+    return waitUntil(next);
+}
+
+pmScheduler::Action pmScheduler::waitUntil(unsigned long long deadline) {
+    if (now() < deadline) {
+        struct timespec ts;
+        ts.tv_sec = deadline / 1000000000ull;
+        ts.tv_nsec = deadline % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+            // EINTR: the deadline is absolute, just go back to sleep
+        }
+    }
+    unsigned long long lateness = now() - deadline;
+    next = deadline + period;
+
+    frames++;
+    hist[std::min(lateness / BUCKETNS, (unsigned long long)NBUCKETS)]++;
+    if (lateness > maxns) maxns = lateness;
+    if (lateness <= period) return SHOW;
+    late++;
+    return policy == LATE_SKIP ? SKIP : NOSHOW;
+}
+
+// Upper edge of the bucket holding the p-th fraction of the samples.
+double pmScheduler::percentile(double p) const {
+    unsigned long long want = p * frames, seen = 0;
+    for (int i = 0; i <= NBUCKETS; i++) {
+        seen += hist[i];
+        if (seen > want) return i < NBUCKETS ? (i + 1) * (BUCKETNS / 1e6) : maxns / 1e6;
+    }
+    return maxns / 1e6;
+}
+
+void pmScheduler::report(std::ostream &os) const {
+    if (frames == 0) return;
+    os << "Frame pacing: " << frames << " frames, wakeup jitter p50 " << percentile(0.5)
+       << " ms, p99 " << percentile(0.99) << " ms, max " << maxns / 1e6 << " ms; "
+       << late << " late frames " << (policy == LATE_SKIP ? "skipped" : "rendered but not shown");
+    if (resyncs > 0) os << ", " << resyncs << " resyncs";
+    os << std::endl;
+}
@@ -0,0 +1,68 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmScheduler.hpp
+* Frame pacing against absolute CLOCK_MONOTONIC deadlines, with a policy
+* for frames that miss theirs and a wakeup jitter histogram.
+*
+*/
+
+
+#ifndef pmScheduler_hpp
+#define pmScheduler_hpp
+
+#include <vector>
+#include <iostream>
+
+class pmScheduler {
+public:
+    // What to do with a frame that is more than one period late.
+    enum Policy { LATE_SKIP, LATE_NOSHOW };
+    enum Action { SHOW, SKIP, NOSHOW };
+
+    pmScheduler();
+
+    void start(int fps, Policy policy);
+
+    // Sleep until the next deadline on the fps grid.
+    Action wait();
+    // Sleep until an absolute deadline taken from some other clock (the
+    // audio device); the grid continues from there.
+    Action waitUntil(unsigned long long deadline);
+
+    static unsigned long long now();
+
+    void report(std::ostream &os) const;
+
+    Policy policy;
+
+private:
+    enum { BUCKETNS = 10000, NBUCKETS = 10000 };  // 10 us up to 100 ms
+
+    unsigned long long period, next;
+    std::vector<unsigned int> hist;
+    unsigned long long frames, late, resyncs, maxns;
+
+    double percentile(double p) const;
+};
+
+#endif /* pmScheduler_hpp */
@@ -0,0 +1,186 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmSegments.cpp
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <iostream>
+
+#include "pmSegments.hpp"
+
+void pmSegments::plan(int n, long long totalframes, long long prerollframes, const std::string &videoName) {
+    segs.clear();
+    if (n > totalframes) n = totalframes > 0 ? totalframes : 1;
+    for (int i = 0; i < n; i++) {
+        pmSegment s;
+        s.index = i;
+        s.first = totalframes * i / n;
+        s.count = i == n - 1 ? -1 : totalframes * (i + 1) / n - s.first;
+        s.preroll = s.first < prerollframes ? s.first : prerollframes;
+        // Matroska takes any codec ffmpeg or libavformat may be asked for
+        s.path = videoName + ".seg" + std::to_string(i) + ".mkv";
+        s.pcmpath = videoName + ".seg" + std::to_string(i) + ".pcm";
+        s.pid = -1;
+        segs.push_back(s);
+    }
+    listPath = videoName + ".segments.txt";
+}
+
+const pmSegment *pmSegments::spawn(std::string &err) {
+    for (size_t i = 0; i < segs.size(); i++) {
+        // nothing buffered may be flushed twice
+        fflush(stdout);
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid < 0) {
+            err = std::string("worker process creation error ") + strerror(errno);
+            return NULL;
+        } else if (pid == 0) {
+            return &segs[i];
+        }
+        segs[i].pid = pid;
+    }
+    return NULL;
+}
+
+bool pmSegments::wait() {
+    bool ok = true;
+    for (size_t i = 0; i < segs.size(); i++) {
+        if (segs[i].pid <= 0) {
+            ok = false;
+            continue;
+        }
+        int status;
+        while (waitpid(segs[i].pid, &status, 0) < 0 && errno == EINTR);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "segment " << i << " worker failed" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Write all of the file at path to fd.
+static bool copyFile(const std::string &path, int fd) {
+    int in = open(path.c_str(), O_RDONLY);
+    if (in < 0) return false;
+    char buf[65536];
+    bool ok = true;
+    for (;;) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        for (ssize_t done = 0; ok && done < n; ) {
+            ssize_t w = write(fd, buf + done, n - done);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) ok = false;
+            else done += w;
+        }
+        if (!ok) break;
+    }
+    close(in);
+    return ok;
+}
+
+bool pmSegments::stitch(const std::string &videoName, int samplerate, int channels, bool floatpcm, std::string &err) {
+    std::ofstream list(listPath.c_str());
+    for (size_t i = 0; i < segs.size(); i++) {
+        // the concat demuxer resolves relative names against the list file
+        std::string p = segs[i].path;
+        if (p[0] != '/') {
+            char cwd[4096];
+            if (getcwd(cwd, sizeof(cwd)) != NULL) p = std::string(cwd) + "/" + p;
+        }
+        list << "file '" << p << "'" << std::endl;
+    }
+    list.close();
+    if (!list) {
+        err = "cannot write " + listPath;
+        return false;
+    }
+
+    int audpipe[2];
+    if (pipe(audpipe) == -1) {
+        err = std::string("audio pipe creation error ") + strerror(errno);
+        return false;
+    }
+    char apipebuf[20];
+    snprintf(apipebuf, 19, "pipe:%d", audpipe[0]);
+    char ratebuf[20];
+    snprintf(ratebuf, 19, "%d", samplerate);
+    char chbuf[10];
+    snprintf(chbuf, 9, "%d", channels);
+    const char *ffmargs[] = { "ffmpeg", "-y", "-f", "concat", "-safe", "0", "-i", listPath.c_str(),
+                              "-f", floatpcm ? "f32le" : "s16le", "-ar", ratebuf, "-ac", chbuf,
+                              "-i", apipebuf,
+                              "-map", "0:v", "-map", "1:a", "-c:v", "copy", "-c:a", "aac",
+                              videoName.c_str(), NULL };
+    // ffmpeg may give up before it has read all the audio
+    signal(SIGPIPE, SIG_IGN);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(audpipe[0]);
+        close(audpipe[1]);
+        err = std::string("ffmpeg process creation error ") + strerror(errno);
+        return false;
+    } else if (pid == 0) {
+        close(audpipe[1]);
+        execvp("ffmpeg", (char **)ffmargs);
+        std::cerr << "ffmpeg process exec error " << strerror(errno) << std::endl;
+        _exit(EXIT_FAILURE);
+    }
+    close(audpipe[0]);
+    bool sent = true;
+    for (size_t i = 0; i < segs.size() && sent; i++) {
+        sent = copyFile(segs[i].pcmpath, audpipe[1]);
+        if (!sent) err = "cannot pass " + segs[i].pcmpath + " to ffmpeg";
+    }
+    close(audpipe[1]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        err = "ffmpeg could not concatenate the segments";
+        return false;
+    }
+    return sent;
+}
+
+void pmSegments::cleanup() {
+    for (size_t i = 0; i < segs.size(); i++) {
+        unlink(segs[i].path.c_str());
+        unlink(segs[i].pcmpath.c_str());
+    }
+    if (!listPath.empty()) unlink(listPath.c_str());
+}
@@ -0,0 +1,81 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmSegments.hpp
+* Parallel export (-j): the track is cut into time segments, each one
+* rendered by a forked worker with its own offscreen context into a
+* video-only file, then the segments are concatenated without
+* re-encoding and muxed with the audio.
+*
+* The audio is not decoded again for the mux: each worker also writes
+* the PCM it fed projectM while exporting, -b/-a silence and the padded
+* last block included, next to its segment. Every frame carries the same
+* number of samples, so the parent passing those files to ffmpeg in
+* order gives a track that stays sample aligned with the video.
+*
+*/
+
+
+#ifndef pmSegments_hpp
+#define pmSegments_hpp
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+struct pmSegment {
+    int index;
+    long long first;        // first video frame of the audio part
+    long long count;        // frames to export, -1 for up to the end
+    long long preroll;      // frames rendered before first, not exported
+    std::string path;
+    std::string pcmpath;    // raw samples of the exported frames
+    pid_t pid;
+};
+
+class pmSegments {
+public:
+    // Cut totalframes video frames into n segments, each warmed up with
+    // at most prerollframes frames of the audio before it.
+    void plan(int n, long long totalframes, long long prerollframes, const std::string &videoName);
+
+    // Fork one worker per segment. Returns the segment in each worker and
+    // NULL in the parent (also when a fork fails, with err set).
+    const pmSegment *spawn(std::string &err);
+
+    // Parent: wait for every worker, true if all of them succeeded.
+    bool wait();
+
+    // Parent: concatenate the segments into videoName with the workers'
+    // PCM (interleaved s16, or f32 if floatpcm) as the audio.
+    bool stitch(const std::string &videoName, int samplerate, int channels, bool floatpcm, std::string &err);
+
+    // Remove the segment, PCM and list files.
+    void cleanup();
+
+    std::vector<pmSegment> segs;
+
+private:
+    std::string listPath;
+};
+
+#endif /* pmSegments_hpp */
@@ -0,0 +1,218 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmShaderCache.cpp
+*
+*/
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "projectM-opengl.h"
+#include "pmShaderCache.hpp"
+
+namespace {
+
+typedef void (APIENTRY *LinkProgramFn)(GLuint);
+
+struct Header {
+    char magic[4];              // "PMSC"
+    uint32_t format;            // binaryFormat for glProgramBinary
+    uint64_t linkns;            // what the link cost when it was cached
+};
+
+bool enabled = false;
+std::string cacheDir;
+std::string driver;             // vendor, renderer and version strings
+unsigned long long hits = 0, misses = 0, rejected = 0, stores = 0;
+unsigned long long savedns = 0, linkns = 0, loadns = 0;
+
+unsigned long long nowns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// FNV-1a, plenty for telling shader sources apart
+void hash(uint64_t &h, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+}
+
+std::string programKey(GLuint program) {
+    uint64_t h = 14695981039346656037ull;
+    hash(h, driver.data(), driver.size());
+    GLint n = 0;
+    glGetProgramiv(program, GL_ATTACHED_SHADERS, &n);
+    std::vector<GLuint> shaders(n > 0 ? n : 1);
+    glGetAttachedShaders(program, n, &n, shaders.data());
+    std::vector<char> src;
+    for (GLint i = 0; i < n; i++) {
+        GLint type = 0, len = 0;
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &len);
+        src.resize(len > 0 ? len : 1);
+        glGetShaderSource(shaders[i], src.size(), &len, src.data());
+        hash(h, &type, sizeof(type));
+        hash(h, src.data(), len);
+    }
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+    return buf;
+}
+
+bool linked(GLuint program) {
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    return ok == GL_TRUE;
+}
+
+bool load(GLuint program, const std::string &path) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL) return false;
+    Header hdr;
+    std::vector<char> blob;
+    bool ok = fread(&hdr, sizeof(hdr), 1, f) == 1 && memcmp(hdr.magic, "PMSC", 4) == 0;
+    if (ok) {
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f) - (long)sizeof(hdr);
+        fseek(f, sizeof(hdr), SEEK_SET);
+        ok = len > 0;
+        if (ok) {
+            blob.resize(len);
+            ok = fread(blob.data(), len, 1, f) == 1;
+        }
+    }
+    fclose(f);
+    if (ok) {
+        glProgramBinary(program, hdr.format, blob.data(), blob.size());
+        ok = linked(program);
+        if (ok) savedns += hdr.linkns;
+    }
+    if (!ok) {
+        // stale or from another driver build: drop it, it gets relinked
+        rejected++;
+        unlink(path.c_str());
+    }
+    return ok;
+}
+
+void store(GLuint program, const std::string &path, unsigned long long ns) {
+    GLint len = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0) return;
+    std::vector<char> blob(len);
+    GLenum format;
+    glGetProgramBinary(program, len, &len, &format, blob.data());
+    Header hdr;
+    memcpy(hdr.magic, "PMSC", 4);
+    hdr.format = format;
+    hdr.linkns = ns;
+    // write and rename, parallel segment workers share the directory
+    std::string tmp = path + "." + std::to_string(getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) return;
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(blob.data(), len, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (ok && rename(tmp.c_str(), path.c_str()) == 0) {
+        stores++;
+    } else {
+        unlink(tmp.c_str());
+    }
+}
+
+bool mkdirs(const std::string &dir) {
+    for (size_t i = 1; i <= dir.size(); i++) {
+        if (i == dir.size() || dir[i] == '/') {
+            std::string d = dir.substr(0, i);
+            if (mkdir(d.c_str(), 0755) < 0 && errno != EEXIST) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool pmShaderCache::init(const std::string &dir) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (dir.empty() || formats <= 0 || !mkdirs(dir)) {
+        enabled = false;
+        return false;
+    }
+    cacheDir = dir;
+    driver = std::string((const char *)glGetString(GL_VENDOR)) + "\n" +
+             (const char *)glGetString(GL_RENDERER) + "\n" +
+             (const char *)glGetString(GL_VERSION);
+    enabled = true;
+    return true;
+}
+
+std::string pmShaderCache::defaultDir() {
+    const char *home = getenv("HOME");
+    if (home == NULL || *home == '\0') return "";
+    return std::string(home) + "/.projectM/shadercache";
+}
+
+void pmShaderCache::report(std::ostream &os) {
+    if (!enabled) return;
+    os << "Shader cache (" << cacheDir << "): " << hits << " hits, " << misses << " misses, "
+       << rejected << " rejected, " << stores << " stored; loading took " << loadns / 1e6
+       << " ms instead of ~" << savedns / 1e6 << " ms of linking, " << linkns / 1e6
+       << " ms spent linking misses" << std::endl;
+}
+
+extern "C" void APIENTRY glLinkProgram(GLuint program) {
+    static LinkProgramFn realLink = (LinkProgramFn)dlsym(RTLD_NEXT, "glLinkProgram");
+
+    if (!enabled) {
+        realLink(program);
+        return;
+    }
+
+    unsigned long long t0 = nowns();
+    std::string path = cacheDir + "/" + programKey(program) + ".bin";
+    if (load(program, path)) {
+        hits++;
+        loadns += nowns() - t0;
+        return;
+    }
+
+    misses++;
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    t0 = nowns();
+    realLink(program);
+    unsigned long long ns = nowns() - t0;
+    linkns += ns;
+    if (linked(program)) store(program, path, ns);
+}
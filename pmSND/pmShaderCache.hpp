@@ -0,0 +1,49 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmShaderCache.hpp
+* On-disk cache of linked shader programs. libprojectM compiles and
+* links every preset's GLSL itself, so the cache sits in front of
+* glLinkProgram: this executable defines that symbol, and the dynamic
+* linker binds libprojectM's calls to it. A program whose sources and
+* driver match a cached entry is loaded with glProgramBinary instead of
+* being linked; anything the driver rejects is relinked and replaced.
+*
+*/
+
+
+#ifndef pmShaderCache_hpp
+#define pmShaderCache_hpp
+
+#include <string>
+#include <iostream>
+
+namespace pmShaderCache {
+    // Start caching in dir, for the current GL context. Without this call
+    // (or if the driver has no binary formats) linking is passed through.
+    bool init(const std::string &dir);
+    // ~/.projectM/shadercache, or empty if there is no home directory.
+    std::string defaultDir();
+    void report(std::ostream &os);
+}
+
+#endif /* pmShaderCache_hpp */
@@ -0,0 +1,130 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmStream.cpp
+*
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "pmStream.hpp"
+#include "pmScheduler.hpp"
+
+pmStreamWatch::pmStreamWatch() : quit(false) {
+    ifd = -1;
+    seglen = 0;
+    fps = 0;
+    segments = 0;
+    sumlatency = maxlatency = sumrender = 0;
+}
+
+pmStreamWatch::~pmStreamWatch() {
+    stop();
+}
+
+bool pmStreamWatch::start(const std::string &_dir, double _seglen, int _fps, std::string &err) {
+    dir = _dir;
+    seglen = _seglen;
+    fps = _fps;
+    if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        err = "cannot create stream directory " + dir + ": " + strerror(errno);
+        return false;
+    }
+    ifd = inotify_init1(IN_CLOEXEC);
+    // ffmpeg writes each segment to a .tmp file and renames it when done
+    if (ifd < 0 || inotify_add_watch(ifd, dir.c_str(), IN_MOVED_TO | IN_CLOSE_WRITE) < 0) {
+        err = "cannot watch " + dir + ": " + strerror(errno);
+        return false;
+    }
+    quit = false;
+    watcher = std::thread(&pmStreamWatch::run, this);
+    return true;
+}
+
+void pmStreamWatch::stop() {
+    if (watcher.joinable()) {
+        quit = true;
+        watcher.join();
+    }
+    if (ifd >= 0) close(ifd);
+    ifd = -1;
+}
+
+void pmStreamWatch::frameSent(unsigned long long frame) {
+    std::lock_guard<std::mutex> g(lock);
+    if (frame >= sent.size()) sent.resize(frame + 1, 0);
+    sent[frame] = pmScheduler::now();
+}
+
+void pmStreamWatch::run() {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { ifd, POLLIN, 0 };
+    // keep reading until stop(), which comes after ffmpeg has exited
+    while (!quit) {
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        ssize_t n = read(ifd, buf, sizeof(buf));
+        if (n <= 0) continue;
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            int index;
+            char ext[8];
+            if (ev->len > 0 && sscanf(ev->name, "seg%d.%7s", &index, ext) == 2 && strcmp(ext, "m4s") == 0) {
+                landed(index);
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+// Segment index holds frames [index, index + 1) * seglen * fps.
+void pmStreamWatch::landed(int index) {
+    unsigned long long now = pmScheduler::now();
+    unsigned long long first = (unsigned long long)(index * seglen * fps);
+    unsigned long long last = (unsigned long long)((index + 1) * seglen * fps) - 1;
+    std::lock_guard<std::mutex> g(lock);
+    if (sent.empty()) return;
+    if (last >= sent.size()) last = sent.size() - 1;   // the short final segment
+    if (first > last || sent[first] == 0 || sent[last] == 0) return;
+    double render = (sent[last] - sent[first]) / 1e9;
+    double latency = (now - sent[last]) / 1e9;
+    segments++;
+    sumrender += render;
+    sumlatency += latency;
+    if (latency > maxlatency) maxlatency = latency;
+    std::cout << "Segment " << index << " (" << index * seglen << "-" << (last + 1.0) / fps << " s): frames rendered in "
+              << render << " s, on disk " << latency << " s after the last one" << std::endl;
+}
+
+void pmStreamWatch::report(std::ostream &os) const {
+    std::lock_guard<std::mutex> g(lock);
+    if (segments == 0) return;
+    os << "Stream: " << segments << " segments of " << seglen << " s in " << dir << ", render "
+       << sumrender / segments << " s per segment, render-to-disk latency mean "
+       << sumlatency / segments << " s, max " << maxlatency << " s" << std::endl;
+}
@@ -0,0 +1,81 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmStream.hpp
+* Streaming output (-S): ffmpeg writes HLS with fragmented MP4 segments
+* of a fixed length into the -v directory while rendering goes on, so the
+* playlist can be served and played long before the set is finished.
+*
+* pmStreamWatch follows the directory with inotify and times every
+* segment as it lands: how long its frames took to render and how long
+* after its last frame left the renderer it was on disk.
+*
+*/
+
+
+#ifndef pmStream_hpp
+#define pmStream_hpp
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+
+class pmStreamWatch {
+public:
+    pmStreamWatch();
+    ~pmStreamWatch();
+
+    // Create dir if needed and start watching it for segments of
+    // seglen seconds at fps frames per second.
+    bool start(const std::string &dir, double seglen, int fps, std::string &err);
+    void stop();
+
+    // Render thread: frame number frame has been handed to the encoder.
+    void frameSent(unsigned long long frame);
+
+    void report(std::ostream &os) const;
+
+    // What ffmpeg is told to write.
+    static std::string playlist(const std::string &dir) { return dir + "/index.m3u8"; }
+    static std::string segmentPattern(const std::string &dir) { return dir + "/seg%05d.m4s"; }
+
+private:
+    int ifd;
+    std::string dir;
+    double seglen;
+    int fps;
+    std::thread watcher;
+    std::atomic<bool> quit;
+
+    mutable std::mutex lock;
+    std::vector<unsigned long long> sent;   // when each frame went to the encoder
+    unsigned long long segments;
+    double sumlatency, maxlatency, sumrender;
+
+    void run();
+    void landed(int index);
+};
+
+#endif /* pmStream_hpp */
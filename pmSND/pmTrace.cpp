@@ -0,0 +1,208 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmTrace.cpp
+*
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "pmTrace.hpp"
+
+namespace {
+
+const char *stageNames[pmTrace::NSTAGES] = {
+    "frame", "pace", "render", "texture", "swap", "yuv", "scale", "capture", "map",
+    "send", "audio", "pcm", "events", "decode", "alsa", "pipe",
+    "gpu render", "gpu texture", "gpu readback", "gpu scale", "gpu frame"
+};
+
+// Quarter-octave buckets of the span length in ns: bucket b covers
+// [2^(b/4), 2^((b+1)/4)), which is fine enough for percentiles.
+const int NBUCKETS = 160;
+
+struct Hist {
+    std::atomic<unsigned long long> count, sumns, maxns;
+    std::atomic<unsigned int> buckets[NBUCKETS];
+};
+Hist hists[pmTrace::NSTAGES];
+
+struct Event {
+    unsigned long long start, end;
+    int tid;
+    int stage;
+};
+std::vector<Event> events;
+std::atomic<size_t> nevents(0);
+size_t maxEvents = 0;
+
+std::mutex namesLock;
+std::vector<std::pair<int, std::string> > threadNames;
+
+int tid() {
+    static thread_local int t = syscall(SYS_gettid);
+    return t;
+}
+
+int bucketOf(unsigned long long ns) {
+    if (ns < 1) return 0;
+    int b = (int)(log2((double)ns) * 4);
+    return b < NBUCKETS ? b : NBUCKETS - 1;
+}
+
+double percentile(const Hist &h, double p) {
+    unsigned long long n = h.count.load(std::memory_order_relaxed), want = p * n, seen = 0;
+    for (int b = 0; b < NBUCKETS; b++) {
+        seen += h.buckets[b].load(std::memory_order_relaxed);
+        if (seen > want) return pow(2.0, (b + 1) / 4.0) / 1e6;
+    }
+    return h.maxns.load(std::memory_order_relaxed) / 1e6;
+}
+
+// trace track for GPU spans; real thread ids are never 0
+const int GPUTID = 0;
+
+void add(pmTrace::Stage stage, unsigned long long startns, unsigned long long endns, int track) {
+    unsigned long long ns = endns - startns;
+    Hist &h = hists[stage];
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sumns.fetch_add(ns, std::memory_order_relaxed);
+    h.buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    unsigned long long m = h.maxns.load(std::memory_order_relaxed);
+    while (ns > m && !h.maxns.compare_exchange_weak(m, ns, std::memory_order_relaxed));
+
+    if (maxEvents > 0) {
+        size_t i = nevents.fetch_add(1, std::memory_order_relaxed);
+        if (i < maxEvents) {
+            Event &e = events[i];
+            e.start = startns;
+            e.end = endns;
+            e.tid = track;
+            e.stage = stage;
+        }
+    }
+}
+
+}
+
+unsigned long long pmTrace::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void pmTrace::enableTrace(size_t maxevents) {
+    events.resize(maxevents);
+    maxEvents = maxevents;
+}
+
+void pmTrace::nameThread(const char *name) {
+    std::lock_guard<std::mutex> g(namesLock);
+    threadNames.push_back(std::make_pair(tid(), std::string(name)));
+}
+
+void pmTrace::record(Stage stage, unsigned long long startns, unsigned long long endns) {
+    add(stage, startns, endns, tid());
+}
+
+void pmTrace::recordGpu(Stage stage, unsigned long long startns, unsigned long long endns) {
+    add(stage, startns, endns, GPUTID);
+}
+
+unsigned long long pmTrace::count(Stage stage) {
+    return hists[stage].count.load(std::memory_order_relaxed);
+}
+
+double pmTrace::totalms(Stage stage) {
+    return hists[stage].sumns.load(std::memory_order_relaxed) / 1e6;
+}
+
+double pmTrace::percentile(Stage stage, double p) {
+    return hists[stage].count.load(std::memory_order_relaxed) > 0 ? ::percentile(hists[stage], p) : 0;
+}
+
+void pmTrace::report(std::ostream &os) {
+    bool header = false;
+    for (int s = 0; s < NSTAGES; s++) {
+        const Hist &h = hists[s];
+        unsigned long long n = h.count.load(std::memory_order_relaxed);
+        if (n == 0) continue;
+        if (!header) {
+            os << "Stage timings (ms):          count      mean       p50       p99       max" << std::endl;
+            header = true;
+        }
+        char line[128];
+        snprintf(line, sizeof(line), "    %-12s %17llu %9.3f %9.3f %9.3f %9.3f", stageNames[s], n,
+                 h.sumns.load(std::memory_order_relaxed) / 1e6 / n, percentile(h, 0.5), percentile(h, 0.99),
+                 h.maxns.load(std::memory_order_relaxed) / 1e6);
+        os << line << std::endl;
+    }
+    if (maxEvents > 0 && nevents.load() > maxEvents) {
+        os << "Trace buffer full: " << nevents.load() - maxEvents << " spans not kept" << std::endl;
+    }
+}
+
+bool pmTrace::writeChrome(const std::string &path, std::string &err) {
+    std::ofstream out(path.c_str());
+    int pid = getpid();
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> g(namesLock);
+        for (size_t i = 0; i < threadNames.size(); i++) {
+            out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+                << ", \"tid\": " << threadNames[i].first << ", \"args\": {\"name\": \"" << threadNames[i].second << "\"}}";
+            first = false;
+        }
+    }
+    if (hists[GPU_FRAME].count.load() > 0) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+            << ", \"tid\": " << GPUTID << ", \"args\": {\"name\": \"GPU\"}}";
+        first = false;
+    }
+    size_t n = nevents.load();
+    if (n > maxEvents) n = maxEvents;
+    char buf[256];
+    for (size_t i = 0; i < n; i++) {
+        const Event &e = events[i];
+        // microseconds, as the format wants
+        snprintf(buf, sizeof(buf), "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                 stageNames[e.stage], pid, e.tid, e.start / 1e3, (e.end - e.start) / 1e3);
+        out << (first ? "" : ",\n") << buf;
+        first = false;
+    }
+    out << "\n]}\n";
+    out.close();
+    if (!out) {
+        err = "cannot write trace " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmTrace.hpp
+* Frame stage timing. Every instrumented stage feeds a histogram that is
+* printed at exit; with -T the individual spans are also kept and written
+* as a Chrome trace-event file (chrome://tracing, Perfetto) at exit.
+* Recording is a couple of clock reads and relaxed atomic adds per span,
+* from any thread. GPU stages are timed by pmGpuTimer and reported in
+* the same table.
+*
+*/
+
+
+#ifndef pmTrace_hpp
+#define pmTrace_hpp
+
+#include <string>
+#include <iostream>
+
+namespace pmTrace {
+    enum Stage {
+        FRAME,          // one whole oneframe() call
+        PACE,           // waiting for the frame's deadline
+        RENDER,         // projectM::renderFrame()
+        TEXTURE,        // renderTexture()
+        SWAP,           // SDL_GL_SwapWindow()
+        YUV,            // GPU colour conversion pass
+        SCALE,          // -G output scaling, or the governor's stretch to the window
+        CAPTURE,        // glReadPixels into a PBO
+        MAP,            // waiting for and mapping a finished PBO
+        SEND,           // handing the frame to the encoder queue / libavcodec
+        AUDIO,          // taking the next PCM block from the prefetch ring
+        PCM,            // feeding projectM's PCM buffer and the encoder's audio
+        EVENTS,         // SDL event polling
+        DECODE,         // sf_readf_* in the decoder thread
+        ALSA,           // snd_pcm_writei in the playback thread
+        PIPE,           // vmsplice/write to ffmpeg in the writer thread
+        GPU_RENDER,     // GPU time of projectM::renderFrame() (see pmGpuTimer)
+        GPU_TEXTURE,    // GPU time of renderTexture()
+        GPU_READBACK,   // GPU time of the PBO glReadPixels
+        GPU_SCALE,      // GPU time of the -G output scaling (pmScaler)
+        GPU_FRAME,      // first to last GPU stage of a frame
+        NSTAGES
+    };
+
+    // Keep up to maxevents spans for writeChrome().
+    void enableTrace(size_t maxevents);
+    // Label the calling thread in the trace.
+    void nameThread(const char *name);
+
+    unsigned long long now();
+    void record(Stage stage, unsigned long long startns, unsigned long long endns);
+    // Same for a span measured on the GPU, shown on a track of its own.
+    void recordGpu(Stage stage, unsigned long long startns, unsigned long long endns);
+
+    class Scope {
+    public:
+        Scope(Stage s) : stage(s), start(now()) {}
+        ~Scope() { record(stage, start, now()); }
+    private:
+        Stage stage;
+        unsigned long long start;
+    };
+
+    // Totals and percentiles (in ms) of one stage so far; p = 1 is the max.
+    unsigned long long count(Stage stage);
+    double totalms(Stage stage);
+    double percentile(Stage stage, double p);
+
+    void report(std::ostream &os);
+    bool writeChrome(const std::string &path, std::string &err);
+}
+
+#define PM_TRACE_CAT(a, b) a##b
+#define PM_TRACE_VAR(line) PM_TRACE_CAT(pmTraceScope, line)
+#define PM_TRACE(stage) pmTrace::Scope PM_TRACE_VAR(__LINE__)(pmTrace::stage)
+
+#endif /* pmTrace_hpp */
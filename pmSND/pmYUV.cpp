@@ -0,0 +1,168 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmYUV.cpp
+*
+*/
+
+#include <SDL2/SDL.h>
+
+#include "pmYUV.hpp"
+#include "Renderer/ShaderEngine.hpp"
+
+// Colour conversion for video export: the rendered frame is copied to a
+// texture, then one fragment per output byte writes a W x 3H/2 single
+// channel target laid out exactly as a yuv420p (or nv12) frame, so a
+// single glReadPixels returns all planes. BT.601 limited range, which is
+// what ffmpeg assumes for untagged yuv420p. Rows stay in GL order, like
+// the BGRA readback.
+static const char *yuvVertexShader =
+    "#version 330 core\n"
+    "void main() {\n"
+    "    vec2 p = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID & 2) * 2 - 1);\n"
+    "    gl_Position = vec4(p, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *yuvFragmentShader =
+    "#version 330 core\n"
+    "uniform sampler2D src;\n"
+    "uniform ivec2 size;\n"
+    "uniform int nv12;\n"
+    "out vec4 color;\n"
+    "float Y(vec3 c)  { return (16.0  + 65.481 * c.r + 128.553 * c.g + 24.966 * c.b) / 255.0; }\n"
+    "float Cb(vec3 c) { return (128.0 - 37.797 * c.r -  74.203 * c.g + 112.0  * c.b) / 255.0; }\n"
+    "float Cr(vec3 c) { return (128.0 + 112.0  * c.r -  93.786 * c.g - 18.214 * c.b) / 255.0; }\n"
+    "vec3 block(ivec2 c) {\n"
+    "    ivec2 p = c * 2;\n"
+    "    return 0.25 * (texelFetch(src, p, 0).rgb + texelFetch(src, p + ivec2(1, 0), 0).rgb +\n"
+    "                   texelFetch(src, p + ivec2(0, 1), 0).rgb + texelFetch(src, p + ivec2(1, 1), 0).rgb);\n"
+    "}\n"
+    "void main() {\n"
+    "    ivec2 o = ivec2(gl_FragCoord.xy);\n"
+    "    if (o.y < size.y) {\n"
+    "        color = vec4(Y(texelFetch(src, o, 0).rgb));\n"
+    "        return;\n"
+    "    }\n"
+    "    int r = o.y - size.y;\n"
+    "    if (nv12 != 0) {\n"
+    "        vec3 c = block(ivec2(o.x / 2, r));\n"
+    "        color = vec4((o.x & 1) == 0 ? Cb(c) : Cr(c));\n"
+    "    } else {\n"
+    "        int cw = size.x / 2;\n"
+    "        int plane = cw * (size.y / 2);\n"
+    "        int idx = r * size.x + o.x;\n"
+    "        bool v = idx >= plane;\n"
+    "        if (v) idx -= plane;\n"
+    "        vec3 c = block(ivec2(idx % cw, idx / cw));\n"
+    "        color = vec4(v ? Cr(c) : Cb(c));\n"
+    "    }\n"
+    "}\n";
+
+pmYUV::pmYUV() {
+    width = height = 0;
+    nv12 = false;
+    programID = vao = srcFBO = srcTex = fbo = tex = 0;
+}
+
+pmYUV::~pmYUV() {
+    destroy();
+}
+
+void pmYUV::destroy() {
+    if (programID == 0) return;
+    glDeleteFramebuffers(1, &srcFBO);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &srcTex);
+    glDeleteTextures(1, &tex);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(programID);
+    programID = vao = srcFBO = srcTex = fbo = tex = 0;
+}
+
+void pmYUV::init(bool _nv12, int w, int h) {
+    destroy();
+    nv12 = _nv12;
+    // chroma is subsampled 2x2: drop an odd last row/column
+    width = w & ~1;
+    height = h & ~1;
+
+    programID = ShaderEngine::CompileShaderProgram(yuvVertexShader, yuvFragmentShader, "yuv");
+    glGenVertexArrays(1, &vao);
+
+    glGenTextures(1, &srcTex);
+    glBindTexture(GL_TEXTURE_2D, srcTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &srcFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, srcFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, srcTex, 0);
+
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height * 3 / 2, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "YUV conversion framebuffer is incomplete\n");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLuint pmYUV::convert(GLuint src) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, src);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, srcFBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean depth = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height * 3 / 2);
+    glUseProgram(programID);
+    glUniform1i(glGetUniformLocation(programID, "src"), 0);
+    glUniform2i(glGetUniformLocation(programID, "size"), width, height);
+    glUniform1i(glGetUniformLocation(programID, "nv12"), nv12);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, srcTex);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (blend) glEnable(GL_BLEND);
+    if (depth) glEnable(GL_DEPTH_TEST);
+
+    return fbo;
+}
@@ -0,0 +1,58 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmYUV.hpp
+* GPU colour conversion for video export (-y): a BGRA frame becomes a
+* W x 3H/2 single channel target holding the yuv420p or nv12 planes, so
+* readback moves 1.5 bytes per pixel instead of 4. One per video output.
+*
+*/
+
+
+#ifndef pmYUV_hpp
+#define pmYUV_hpp
+
+#include "projectM-opengl.h"
+
+class pmYUV {
+public:
+    pmYUV();
+    ~pmYUV();
+
+    // Convert w x h frames (cropped to even sizes).
+    void init(bool nv12, int w, int h);
+    void destroy();
+
+    // Convert the frame in framebuffer src; returns the framebuffer to
+    // read the planes back from.
+    GLuint convert(GLuint src = 0);
+
+    int width, height;
+
+private:
+    bool nv12;
+    GLuint programID, vao;
+    GLuint srcFBO, srcTex;
+    GLuint fbo, tex;
+};
+
+#endif /* pmYUV_hpp */
@@ -34,16 +34,79 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <memory>
 
 #include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <signal.h>
 #include <sndfile.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <alsa/asoundlib.h>
 #include <alsa/pcm.h>
 
 #include "pmSND.hpp"
+#include "pmEGL.hpp"
+#include "pmAudio.hpp"
+#include "pmPCMMap.hpp"
+#include "pmPlayback.hpp"
+#include "pmScheduler.hpp"
+#include "pmSegments.hpp"
+#include "pmBatch.hpp"
+#include "pmShaderCache.hpp"
+#include "pmPresetCatalog.hpp"
+#include "pmBench.hpp"
+#include "pmTrace.hpp"
+#include "pmGpuTimer.hpp"
+#include "pmGovernor.hpp"
+#include "pmRendition.hpp"
+#include "pmPipeIn.hpp"
+
+
+// An audio file argument is a sound file, synth:SECONDS for the
+// built-in test signal, or "-" / a fifo to stream from. raw is the
+// format declared with -r (format 0 if none), for headerless PCM.
+static SNDFILE *openAudio(const std::string &path, const SF_INFO &raw, SF_INFO *info) {
+    double seconds;
+    if (pmSynthName(path, seconds)) {
+	return pmSynthOpen(seconds, info);
+    }
+    if (pmPipeName(path)) {
+	return pmPipeOpen(path, raw, info);
+    }
+    *info = raw;
+    return sf_open(path.c_str(), SFM_READ, info);
+}
 
+// User and system CPU time of the whole process so far, in seconds.
+static void cpuTime(double &user, double &sys) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+    sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+// Make the catalog entries keep (all of them if keep is empty) projectM's
+// playlist, in catalog order.
+static void loadPlaylist(projectM *app, const pmPresetCatalog &catalog, const std::vector<int> &keep) {
+    std::vector<int> ratings(2, 3); // libprojectM's default hard/soft cut ratings
+    app->clearPlaylist();
+    size_t n = keep.empty() ? catalog.entries.size() : keep.size();
+    for (size_t i = 0; i < n; i++) {
+        const pmPresetCatalog::Entry &e = catalog.entries[keep.empty() ? i : keep[i]];
+        app->addPresetURL(e.path, e.name, ratings);
+    }
+}
+
+// Counterpart of openAudio(): also lets go of a pipe's relay.
+static void closeAudio(SNDFILE *sndf) {
+    pmPipeStop(sndf);
+    sf_close(sndf);
+    pmPipeClose(sndf);
+}
 
 void DebugLog(GLenum source,
                GLenum type,
@@ -114,17 +177,46 @@ std::string getConfigFilePath(std::string datadir_path) {
   }
 }
 
-//	-p preset name
+//	-p preset name, or a glob / prefix selecting several presets
 //      -D datadir path
 //      -d playback audio device
 //      -b seconds before audio starts
 //      -a seconds after audio ends
-//      -v video name to be passed to ffmpeg
+//      -v video outputs: path[@WxH][@codec], several comma separated or repeated,
+//         all encoded from the same render (see pmRendition.hpp)
 //      -f <fullscreen>
 //      -x <debug openGL>
+//      -n <no window: render offscreen through EGL, unthrottled>
+//      -g WxH render size (default: usable display bounds, 1920x1080 with -n)
+//      -G WxH video size, if not the render size: the frame is scaled on the GPU
+//      -R readback ring depth (frames in flight between GPU and ffmpeg)
+//      -Q encoder queue length (frames buffered for the ffmpeg writer thread)
+//      -w <plain write() into the ffmpeg pipe instead of vmsplice>
+//      -y yuv420p|nv12 convert to YUV on the GPU before readback
+//      -e ffmpeg|lavc encoder backend: ffmpeg child process or in-process libavcodec
+//      -c video codec (default ffvhuff)
+//      -t encoder threads (lavc only, 0 = codec default)
+//      -F <decode and analyze float PCM instead of 16 bit>
+//      -l skip|noshow late frames in live mode: skip rendering, or render without presenting
+//      -q minscale adapt quality to the frame rate in live mode, rendering at no less
+//         than minscale (0.25-1) of the window size; never with -v
+//      -j N render the video as N time segments in parallel worker processes
+//      -P seconds of audio fed before each segment to warm it up (default 10)
+//      -S seconds stream: write HLS (fragmented MP4 segments of this length and
+//         index.m3u8) into the -v directory as rendering goes on
+//      -B job manifest: render every job listed there in this process (see pmBatch.hpp)
+//      -T FILE write a Chrome trace-event JSON of every frame stage at exit
+//      --bench-presets FILE measure every preset (or the -p selection) on synthetic
+//                      audio and write CSV, or JSON for a .json FILE; -j N workers
+//      --bench-frames N frames measured per preset (default 120)
+//      --bench-json FILE append fps, frame time percentiles and readback/encode
+//                      rates of the whole run to FILE as one JSON line
+//      -r RATE:CHANNELS:s16|f32 the audio is headerless little-endian PCM of this format
+//      audiofile synth:SECONDS renders the built-in test signal (see pmBench.hpp);
+//         - or a fifo streams the audio in as it arrives (see pmPipeIn.hpp)
 
 void usage(char *av0) {
-    std::cerr << "Usage: " << av0 << " [-p preset] [-D datadir] [-d device] [-b before] [-a after] [-s beatsens] [-v video] [-fx] audiofile" << std::endl;
+    std::cerr << "Usage: " << av0 << " [-p preset] [-D datadir] [-d device] [-b before] [-a after] [-s beatsens] [-v video[@WxH][@codec],...] [-g WxH] [-G WxH] [-R depth] [-Q frames] [-w] [-y yuv420p|nv12] [-e ffmpeg|lavc] [-c vcodec] [-t threads] [-l skip|noshow] [-q minscale] [-j segments] [-P preroll] [-S seglen] [-T trace.json] [-r rate:channels:s16|f32] [--bench-json out.jsonl] [-fxnF] audiofile|synth:seconds|- | -B manifest | --bench-presets out.csv|out.json [--bench-frames N]" << std::endl;
     exit(EXIT_FAILURE);
 }
 
@@ -144,12 +236,44 @@ srand((int)(time(NULL)));
     std::string videoName;
     bool fullscrn = false;
     bool dbgogl = false;
+    bool headless = false;
+    int reqwidth = 0, reqheight = 0;
+    int outwidth = 0, outheight = 0;
+    int rbdepth = 3;
+    int queuelen = 8;
+    bool usesplice = true;
+    std::string gpuPixFmt;
+    std::string encoder = "ffmpeg";
+    std::string vcodec = "ffvhuff";
+    int encthreads = 0;
+    bool floatpcm = false;
+    pmScheduler::Policy latepolicy = pmScheduler::LATE_SKIP;
+    float minscale = 0;     // no quality governor
+    double seglen = 0;      // no streaming
+    SF_INFO rawFormat;      // -r: headerless PCM input
+    memset(&rawFormat, 0, sizeof(rawFormat));
+    std::string rawErr;
+    int nsegments = 1;
+    long int preroll = 10;
+    std::string manifest;
+    std::string benchOut;
+    int benchFrames = 120;
+    std::string traceFile;
+    std::string benchJson;
+    const int renderfps = 25; // settings.fps; segments are planned before projectM exists
 
     if (argc == 1) {
 	usage(argv[0]);
     }
 
-    while ((opt = getopt(argc, argv, "v:s:a:b:d:D:p:fx")) != -1) {
+    enum { OPT_BENCH_PRESETS = 256, OPT_BENCH_FRAMES, OPT_BENCH_JSON };
+    static const struct option longopts[] = {
+	{ "bench-presets", required_argument, NULL, OPT_BENCH_PRESETS },
+	{ "bench-frames", required_argument, NULL, OPT_BENCH_FRAMES },
+	{ "bench-json", required_argument, NULL, OPT_BENCH_JSON },
+	{ NULL, 0, NULL, 0 }
+    };
+    while ((opt = getopt_long(argc, argv, "v:s:a:b:d:D:p:g:G:R:Q:y:e:c:t:l:q:j:P:S:B:T:r:fxnwF", longopts, NULL)) != -1) {
 	char *endptr;
 	switch (opt) {
 	    case 'x':
@@ -158,6 +282,134 @@ srand((int)(time(NULL)));
 	    case 'f':
 		fullscrn = true;
 		break;
+	    case 'F':
+		floatpcm = true;
+		break;
+	    case 'l':
+		if (strcmp(optarg, "skip") == 0) {
+		    latepolicy = pmScheduler::LATE_SKIP;
+		} else if (strcmp(optarg, "noshow") == 0) {
+		    latepolicy = pmScheduler::LATE_NOSHOW;
+		} else {
+		    std::cerr << "-l: expected skip or noshow, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'r':
+		if (!pmRawFormat(optarg, &rawFormat, rawErr)) {
+		    std::cerr << rawErr << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'S':
+		seglen = strtod(optarg, &endptr);
+		if (endptr == optarg || seglen <= 0) {
+		    std::cerr << "-S: expected a segment length in seconds, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'q':
+		minscale = strtof(optarg, &endptr);
+		if (endptr == optarg || minscale < 0.25f || minscale > 1.0f) {
+		    std::cerr << "-q: expected a render scale from 0.25 to 1, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'n':
+		headless = true;
+		break;
+	    case 'w':
+		usesplice = false;
+		break;
+	    case 'g':
+		if (sscanf(optarg, "%dx%d", &reqwidth, &reqheight) != 2 || reqwidth <= 0 || reqheight <= 0) {
+		    std::cerr << "-g: expected WxH, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'G':
+		if (sscanf(optarg, "%dx%d", &outwidth, &outheight) != 2 || outwidth <= 0 || outheight <= 0) {
+		    std::cerr << "-G: expected WxH, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'R':
+		rbdepth = strtol(optarg, &endptr, 10);
+		if (endptr == optarg || rbdepth < 2) {
+		    std::cerr << "-R: expected a depth of at least 2, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'j':
+		nsegments = strtol(optarg, &endptr, 10);
+		if (endptr == optarg || nsegments < 1) {
+		    std::cerr << "-j: expected a number of segments, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'P':
+		preroll = strtol(optarg, &endptr, 10);
+		if (endptr == optarg || preroll < 0) {
+		    std::cerr << "-P: cannot convert " << optarg << " to a number" << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'B':
+		manifest = optarg;
+		break;
+	    case 'T':
+		traceFile = optarg;
+		break;
+	    case OPT_BENCH_PRESETS:
+		benchOut = optarg;
+		break;
+	    case OPT_BENCH_FRAMES:
+		benchFrames = strtol(optarg, &endptr, 10);
+		if (endptr == optarg || benchFrames < 1) {
+		    std::cerr << "--bench-frames: expected a number of frames, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case OPT_BENCH_JSON:
+		benchJson = optarg;
+		break;
+	    case 'Q':
+		queuelen = strtol(optarg, &endptr, 10);
+		if (endptr == optarg || queuelen < 2) {
+		    std::cerr << "-Q: expected a queue length of at least 2, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'y':
+		gpuPixFmt = optarg;
+		if (gpuPixFmt != "yuv420p" && gpuPixFmt != "nv12") {
+		    std::cerr << "-y: expected yuv420p or nv12, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'e':
+		encoder = optarg;
+		if (encoder != "ffmpeg" && encoder != "lavc") {
+		    std::cerr << "-e: expected ffmpeg or lavc, got " << optarg << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+#ifndef HAVE_LIBAV
+		if (encoder == "lavc") {
+		    std::cerr << "-e lavc: built without libavcodec, rebuild with make LIBAV=1" << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+#endif
+		break;
+	    case 'c':
+		vcodec = optarg;
+		break;
+	    case 't':
+		encthreads = strtol(optarg, &endptr, 10);
+		if (endptr == optarg || encthreads < 0) {
+		    std::cerr << "-t: cannot convert " << optarg << " to a thread count" << std::endl;
+		    exit(EXIT_FAILURE);
+		}
+		break;
 	    case 'p':
 		presetName = optarg;
 		break;
@@ -168,7 +420,8 @@ srand((int)(time(NULL)));
 		pcmDevice = optarg;
 		break;
 	    case 'v':
-		videoName = optarg;
+		// repeated -v add outputs, like a comma separated list
+		videoName += (videoName.empty() ? "" : ",") + std::string(optarg);
 		break;
 	    case 's':
 		errno = 0;
@@ -196,71 +449,232 @@ srand((int)(time(NULL)));
 		usage(argv[0]);
 	}
     }
-    if ((optind > argc) || (argv[optind] == NULL)) {
-	usage(argv[0]);
+    std::vector<pmJob> jobs;
+    if (!benchOut.empty()) {
+	// the benchmark makes its own audio and renders offscreen
+	headless = true;
+    } else if (!manifest.empty()) {
+	std::string joberr;
+	if (!readManifest(manifest, jobs, joberr)) {
+	    std::cerr << joberr << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+	if (nsegments > 1) {
+	    std::cerr << "-j cannot be combined with -B" << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+    } else {
+	if ((optind > argc) || (argv[optind] == NULL)) {
+	    usage(argv[0]);
+	}
+	pmJob job;
+	job.audioFile = argv[optind];
+	job.presetName = presetName;
+	job.videoName = videoName;
+	job.before = before;
+	job.after = after;
+	jobs.push_back(job);
     }
-    audioFile = argv[optind];
-    if (audioFile.empty()) {
-	usage(argv[0]);
+
+    // every job's -v list is checked before anything is rendered
+    for (size_t i = 0; i < jobs.size(); i++) {
+	std::vector<pmRenditionSpec> specs;
+	std::string rendErr;
+	if (!jobs[i].videoName.empty() && !parseRenditions(jobs[i].videoName, specs, rendErr)) {
+	    std::cerr << rendErr << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+	if (nsegments > 1 && (specs.size() > 1 || (!specs.empty() && (specs[0].width > 0 || !specs[0].codec.empty())))) {
+	    std::cerr << "-j: a single -v output, sized with -G and encoded with -c" << std::endl;
+	    exit(EXIT_FAILURE);
+	}
     }
 
+    if (seglen > 0 && ((videoName.empty() && manifest.empty()) || encoder != "ffmpeg" || nsegments > 1)) {
+	std::cerr << "-S: needs -v (a directory) and the ffmpeg encoder, and cannot be split with -j" << std::endl;
+	exit(EXIT_FAILURE);
+    }
 
     // Open the audio file
 
     SF_INFO sfinfo;
-    SNDFILE *sndf;
+    memset(&sfinfo, 0, sizeof(sfinfo));    // no audio at all with --bench-presets
+    SNDFILE *sndf = NULL;
+
+    if (!jobs.empty()) {
+	audioFile = jobs[0].audioFile;
+	videoName = jobs[0].videoName;
+	before = jobs[0].before;
+	after = jobs[0].after;
+	if (audioFile.empty()) {
+	    usage(argv[0]);
+	}
+	sndf = openAudio(audioFile, rawFormat, &sfinfo);
+	if (sndf == NULL && manifest.empty()) {
+	    std::cerr << "Error opening audio file: " << sf_strerror(NULL) << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+	// in a batch the job loop reports it and goes on with the next job
+	double synthlen;
+	if (pmSynthName(audioFile, synthlen)) {
+	    // the test signal is fixed, so is everything projectM randomizes
+	    srand(1);
+	}
+    }
 
-    sndf = sf_open(audioFile.c_str(), SFM_READ, &sfinfo);
-    if (sndf == NULL) {
-	std::cerr << "Error opening audio file: " << sf_strerror(NULL) << std::endl;
-	exit(EXIT_FAILURE);
+    // Preset benchmark across processes: like the segments below, the
+    // parent forks before any GL setup, then only collects the results.
+    int benchworker = 0, benchworkers = 1;
+    if (!benchOut.empty() && nsegments > 1) {
+	std::vector<pid_t> pids;
+	benchworker = pmBench::spawn(nsegments, pids);
+	if (benchworker < 0) {
+	    bool ok = true;
+	    std::vector<pmBenchResult> results;
+	    for (int i = 0; i < nsegments; i++) {
+		int status;
+		if (pids[i] < 0) {
+		    ok = false;
+		    continue;
+		}
+		while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR);
+		std::string part = benchOut + ".worker" + std::to_string(i);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !pmBench::readRows(part, results)) {
+		    std::cerr << "benchmark worker " << i << " failed" << std::endl;
+		    ok = false;
+		}
+		unlink(part.c_str());
+	    }
+	    std::string benchErr;
+	    if (!pmBench::writeReport(benchOut, results, 1000.0 / 60, benchErr)) {
+		std::cerr << benchErr << std::endl;
+		ok = false;
+	    }
+	    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	benchworkers = nsegments;
     }
 
+    // Parallel export: the parent plans the segments, forks a worker for
+    // each and stitches their output; it never touches GL itself. Each
+    // worker carries on below as an offscreen, video-only export of its
+    // own segment.
+    pmSegments segments;
+    const pmSegment *segment = NULL;
+    FILE *segpcm = NULL;    // a worker's exported samples, muxed by the parent
+    if (nsegments > 1 && benchOut.empty()) {
+	double synthlen;
+	if (videoName.empty() || !pcmDevice.empty() || pmSynthName(audioFile, synthlen) || pmPipeName(audioFile)) {
+	    std::cerr << "-j: needs -v and a seekable sound file, and cannot play audio (-d)" << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+	int segasamples = sfinfo.samplerate / renderfps;
+	segments.plan(nsegments, (sfinfo.frames + segasamples - 1) / segasamples, preroll * renderfps, videoName);
+	closeAudio(sndf);
+	std::string segerr;
+	segment = segments.spawn(segerr);
+	if (segment == NULL) {
+	    if (!segerr.empty()) {
+		std::cerr << segerr << std::endl;
+	    }
+	    bool ok = segments.wait() && segerr.empty();
+	    if (ok && !segments.stitch(videoName, sfinfo.samplerate, sfinfo.channels, floatpcm, segerr)) {
+		std::cerr << segerr << std::endl;
+		ok = false;
+	    }
+	    segments.cleanup();
+	    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	headless = true;
+	videoName = segment->path;
+	if (segment->index > 0) before = 0;
+	if (segment->count >= 0) after = 0;
+	// the parent's handle shares its file offset with every worker
+	sndf = openAudio(audioFile, rawFormat, &sfinfo);
+	if (sndf == NULL) {
+	    std::cerr << "Error opening audio file: " << sf_strerror(NULL) << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+	if (!traceFile.empty()) traceFile += ".seg" + std::to_string(segment->index);
+	segpcm = fopen(segment->pcmpath.c_str(), "wb");
+	if (segpcm == NULL) {
+	    std::cerr << "cannot write " << segment->pcmpath << ": " << strerror(errno) << std::endl;
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    if (!traceFile.empty()) {
+	pmTrace::enableTrace(1 << 20);  // some 15 spans a frame: about 45 minutes at 25 fps
+	pmTrace::nameThread("render");
+    }
 
-    SDL_Init(SDL_INIT_VIDEO);
+
+    if (!headless) {
+        SDL_Init(SDL_INIT_VIDEO);
+    }
 
     if (! SDL_VERSION_ATLEAST(2, 0, 5)) {
         SDL_Log("SDL version 2.0.5 or greater is required. You have %i.%i.%i", SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL);
         return 1;
     }
 
-    SDL_Log("Opened audio file %s: %ld frames, %d channels, samplerate %d\n", audioFile.c_str(), sfinfo.frames, sfinfo.channels, sfinfo.samplerate);
+    if (sndf == NULL) {
+	// the benchmark makes its own audio, a failed batch job is reported later
+    } else if (sfinfo.frames == SF_COUNT_MAX) {
+	SDL_Log("Streaming audio from %s: %d channels, samplerate %d\n", audioFile.c_str(), sfinfo.channels, sfinfo.samplerate);
+    } else {
+	SDL_Log("Opened audio file %s: %ld frames, %d channels, samplerate %d\n", audioFile.c_str(), sfinfo.frames, sfinfo.channels, sfinfo.samplerate);
+    }
 
-    // default window size to usable bounds (e.g. minus menubar and dock)
-    SDL_Rect initialWindowBounds;
+    int width, height;
+    SDL_Window *win = NULL;
+    SDL_GLContext glCtx = NULL;
+    pmEGL egl;
+
+    if (headless) {
+        // no display to take the size from: render exactly what was asked for
+        width = reqwidth ? reqwidth : 1920;
+        height = reqheight ? reqheight : 1080;
+        std::string eglerr;
+        if (!egl.init(width, height, eglerr)) {
+            std::cerr << "cannot create offscreen GL context: " << eglerr << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        // default window size to usable bounds (e.g. minus menubar and dock)
+        SDL_Rect initialWindowBounds;
 #if SDL_VERSION_ATLEAST(2, 0, 5)
-    // new and better
-    SDL_GetDisplayUsableBounds(0, &initialWindowBounds);
+        // new and better
+        SDL_GetDisplayUsableBounds(0, &initialWindowBounds);
 #else
-    SDL_GetDisplayBounds(0, &initialWindowBounds);
+        SDL_GetDisplayBounds(0, &initialWindowBounds);
 #endif
-    int width = initialWindowBounds.w;
-    int height = initialWindowBounds.h;
+        width = reqwidth ? reqwidth : initialWindowBounds.w;
+        height = reqheight ? reqheight : initialWindowBounds.h;
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 
+        win = SDL_CreateWindow("projectM", 0, 0, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
 
-    
-    SDL_Window *win = SDL_CreateWindow("projectM", 0, 0, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
-    
-    SDL_GL_GetDrawableSize(win,&width,&height);
-    
-
-    SDL_GLContext glCtx = SDL_GL_CreateContext(win);
+        SDL_GL_GetDrawableSize(win,&width,&height);
 
+        glCtx = SDL_GL_CreateContext(win);
+    }
 
     SDL_Log("GL_VERSION: %s", glGetString(GL_VERSION));
     SDL_Log("GL_SHADING_LANGUAGE_VERSION: %s", glGetString(GL_SHADING_LANGUAGE_VERSION));
     SDL_Log("GL_VENDOR: %s", glGetString(GL_VENDOR));
 
-    SDL_SetWindowTitle(win, "projectM Visualizer");
+    if (win != NULL) {
+        SDL_SetWindowTitle(win, "projectM Visualizer");
     
-    SDL_GL_MakeCurrent(win, glCtx);  // associate GL context with main window
-    int avsync = SDL_GL_SetSwapInterval(-1); // try to enable adaptive vsync
-    if (avsync == -1) { // adaptive vsync not supported
-        SDL_GL_SetSwapInterval(1); // enable updates synchronized with vertical retrace
+        SDL_GL_MakeCurrent(win, glCtx);  // associate GL context with main window
+        int avsync = SDL_GL_SetSwapInterval(-1); // try to enable adaptive vsync
+        if (avsync == -1) { // adaptive vsync not supported
+            SDL_GL_SetSwapInterval(1); // enable updates synchronized with vertical retrace
+        }
     }
 
     
@@ -275,24 +689,35 @@ srand((int)(time(NULL)));
     }
     SDL_Log("Config file not found, using built-in settings. Data directory=%s\n", base_path.c_str());
 
-    // Get max refresh rate from attached displays to use as built-in max FPS.
-    int i = 0;
-    int maxRefreshRate = 0;
-    SDL_DisplayMode current;
-    for (i = 0; i < SDL_GetNumVideoDisplays(); ++i)
-    {
-	if (SDL_GetCurrentDisplayMode(i, &current) == 0)
-	{
-    	    if (current.refresh_rate > maxRefreshRate) maxRefreshRate = current.refresh_rate;
-	}
+    // before projectM links its first program
+    std::string shaderCacheDir = pmShaderCache::defaultDir();
+    if (shaderCacheDir.empty()) {
+        shaderCacheDir = base_path + "shadercache";
     }
-    if (maxRefreshRate <= 60) maxRefreshRate = 60;
+    if (!pmShaderCache::init(shaderCacheDir)) {
+        SDL_Log("Shader cache disabled: no program binary support or %s not writable\n", shaderCacheDir.c_str());
+    }
+
+    if (win != NULL) {
+        // Get max refresh rate from attached displays to use as built-in max FPS.
+        int i = 0;
+        int maxRefreshRate = 0;
+        SDL_DisplayMode current;
+        for (i = 0; i < SDL_GetNumVideoDisplays(); ++i)
+        {
+	    if (SDL_GetCurrentDisplayMode(i, &current) == 0)
+	    {
+    	        if (current.refresh_rate > maxRefreshRate) maxRefreshRate = current.refresh_rate;
+	    }
+        }
+        if (maxRefreshRate <= 60) maxRefreshRate = 60;
 
-    current.format = SDL_PIXELFORMAT_BGRA32;
+        current.format = SDL_PIXELFORMAT_BGRA32;
 
-    int sdlrc = SDL_SetWindowDisplayMode(win, &current);
-    if (sdlrc < 0) {
-	std::cerr << "cannot set display mode: " << SDL_GetError() << std::endl;
+        int sdlrc = SDL_SetWindowDisplayMode(win, &current);
+        if (sdlrc < 0) {
+	    std::cerr << "cannot set display mode: " << SDL_GetError() << std::endl;
+        }
     }
 
     float heightWidthRatio = (float)height / (float)width;
@@ -301,7 +726,7 @@ srand((int)(time(NULL)));
     settings.windowHeight = height;
     settings.meshX = 128;
     settings.meshY = settings.meshX * heightWidthRatio;
-    settings.fps = 25; //maxRefreshRate;
+    settings.fps = renderfps; //maxRefreshRate;
     settings.smoothPresetDuration = 3; // seconds
     settings.presetDuration = 22; // seconds
     settings.hardcutEnabled = true;
@@ -312,21 +737,67 @@ srand((int)(time(NULL)));
     settings.shuffleEnabled = 1;
     settings.softCutRatingsEnabled = 1; // ???
     // get path to our app, use CWD or resource dir for presets/fonts/etc
-    settings.presetURL = base_path + "presets";
+    // The playlist is filled from the preset index below; libprojectM only
+    // gets the index directory to scan, which holds no presets.
+    pmPresetCatalog catalog;
+    std::string presetIndexDir = pmPresetCatalog::defaultDir();
+    if (presetIndexDir.empty()) {
+        presetIndexDir = base_path + "presetindex";
+    }
+    std::string caterr;
+    bool indexed = catalog.load(base_path + "presets", presetIndexDir, caterr);
+    if (!indexed) {
+        std::cerr << caterr << ", falling back to projectM's own preset scan" << std::endl;
+    }
+    settings.presetURL = indexed ? presetIndexDir : base_path + "presets";
     settings.menuFontURL = base_path + "fonts/Vera.ttf";
     settings.titleFontURL = base_path + "fonts/Vera.ttf";
     // init with settings
+    unsigned long long initstart = pmScheduler::now();
     app = new projectMSND(settings, 0);
+    double initms = (pmScheduler::now() - initstart) / 1e6;
+
+    // A -p pattern matching several presets narrows the playlist to them;
+    // the benchmark measures just the -p selection, even a single preset.
+    // Batch jobs narrow it per job instead (see the job loop).
+    bool benchsel = !benchOut.empty() && !presetName.empty();
+    if (!indexed) {
+        std::vector<std::string> names;
+        for (unsigned int i = 0; i < app->getPlaylistSize(); i++) {
+            names.push_back(app->getPresetName(i));
+        }
+        catalog.adopt(names);
+        for (unsigned int i = 0; i < app->getPlaylistSize(); i++) {
+            catalog.entries[i].path = app->getPresetURL(i);
+        }
+    }
+    std::vector<int> initmatches = catalog.find(presetName);
+    bool narrow = (jobs.size() <= 1 && initmatches.size() > 1) || (benchsel && !initmatches.empty());
+    if (narrow) {
+        catalog.restrict(initmatches);
+    }
+    if (indexed || narrow) {
+        loadPlaylist(app, catalog, std::vector<int>());
+    }
+    std::cout << "projectM init: " << initms << " ms, playlist ready after "
+              << (pmScheduler::now() - initstart) / 1e6 << " ms" << std::endl;
+    if (indexed) {
+        catalog.report(std::cout);
+    }
 
     // Populate the app fields from command line args
 
     app->sndFileName = audioFile;
     app->presetName = presetName;
     app->sndFile = sndf;
-    app->sndInfo = sfinfo;
+    if (sndf != NULL) {
+        app->sndInfo = sfinfo;
+    }
 
     // If our config or hard-coded settings create a resolution smaller than the monitors, then resize the SDL window to match.
-    if (height > app->getWindowHeight() || width > app->getWindowWidth()) {
+    if (win == NULL) {
+        // the pbuffer already has the requested size
+    } else if (height > app->getWindowHeight() || width > app->getWindowWidth()) {
         SDL_SetWindowSize(win, app->getWindowWidth(),app->getWindowHeight());
         SDL_SetWindowPosition(win, (width / 2)-(app->getWindowWidth()/2), (height / 2)-(app->getWindowHeight()/2));
     } else if (height < app->getWindowHeight() || width < app->getWindowWidth()) {
@@ -336,13 +807,18 @@ srand((int)(time(NULL)));
     }
     app->init(win, &glCtx);
 
-    if (fullscrn) {
+    if (fullscrn && win != NULL) {
 	app->setFullScreen();
     }
 
     int wh, ww;
 
-    SDL_GetWindowSize(win, &ww, &wh);
+    if (win != NULL) {
+        SDL_GetWindowSize(win, &ww, &wh);
+    } else {
+        ww = width;
+        wh = height;
+    }
 
     std::cout << "window height: " << wh << " width: " << ww << std::endl;
 
@@ -352,266 +828,537 @@ srand((int)(time(NULL)));
         glDebugMessageCallback(DebugLog, NULL);
     }
 
-#if TEST_ALL_PRESETS
-    uint buildErrors = 0;
-    for(unsigned int i = 0; i < app->getPlaylistSize(); i++) {
-        std::cout << i << "\t" << app->getPresetName(i) << std::endl;
-        app->selectPreset(i);
-        if (app->getErrorLoadingCurrentPreset()) {
-            buildErrors++;
-        }
-    }
-
-    if (app->getPlaylistSize()) {
-        fprintf(stdout, "Preset loading errors: %d/%d [%d%%]\n", buildErrors, app->getPlaylistSize(), (buildErrors*100) / app->getPlaylistSize());
+    if (!benchOut.empty()) {
+	// Each worker takes every benchworkers-th preset of the playlist.
+	pmBench bench(app, benchFrames, 44100, app->settings().fps > 0 ? app->settings().fps : 60);
+	std::vector<pmBenchResult> results;
+	unsigned int buildErrors = 0;
+	for (unsigned int i = benchworker; i < app->getPlaylistSize(); i += benchworkers) {
+	    pmBenchResult r = bench.run(i);
+	    std::cout << i << "\t" << r.name << "\tload " << r.loadms << " ms, cpu " << r.cpumean
+	              << "/" << r.cpup99 << " ms, gpu " << r.gpumean << "/" << r.gpup99 << " ms (mean/p99)"
+	              << (r.error ? "\tLOAD ERROR" : "") << std::endl;
+	    if (r.error) buildErrors++;
+	    results.push_back(r);
+	}
+	if (!results.empty()) {
+	    fprintf(stdout, "Preset loading errors: %u/%zu [%zu%%]\n", buildErrors, results.size(), (buildErrors * 100) / results.size());
+	}
+	bool ok;
+	std::string benchErr;
+	if (benchworkers > 1) {
+	    ok = pmBench::writeRows(benchOut + ".worker" + std::to_string(benchworker), results);
+	} else {
+	    ok = pmBench::writeReport(benchOut, results, 1000.0 / 60, benchErr);
+	    if (!ok) std::cerr << benchErr << std::endl;
+	}
+	pmShaderCache::report(std::cout);
+	delete app;
+	egl.destroy();
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    sf_close(app->sndFile)
-    delete app;
+    // Every job reuses the context, the projectM instance and its preset
+    // playlist; only the audio file, preset and output change. Without
+    // -B there is just the one job from the command line.
+    pmGpuTimer::init();
+
+    // The -v outputs may have sizes of their own (-G, or per output);
+    // frames are scaled on the GPU between rendering and readback, so the
+    // render size (-g, or the window) trades quality for speed
+    // independently of the video. ew x eh is the first output's size.
+    int ew = ww, eh = wh;
+    unsigned long long batchstart = pmScheduler::now(), batchframes = 0, exportbytes = 0;
+    size_t nrenditions = 0;
+    // A job that fails (its audio cannot be opened, an encoder fails) is
+    // reported and the batch goes on; only closing the window stops it.
+    size_t jobsrun = 0, failedjobs = 0;
+    bool jobnarrowed = false;   // the playlist holds only the last job's matches
+    for (size_t jobno = 0; jobno < jobs.size(); jobno++) {
+	unsigned long long jobstart = pmScheduler::now();
+	double jobuser, jobsys;
+	cpuTime(jobuser, jobsys);
+	audioFile = jobs[jobno].audioFile;
+	presetName = jobs[jobno].presetName;
+	videoName = jobs[jobno].videoName;
+	before = jobs[jobno].before;
+	after = jobs[jobno].after;
+	bool jobfailed = false;
+	if (jobno > 0 || sndf == NULL) {
+	    sndf = openAudio(audioFile, rawFormat, &sfinfo);
+	    if (sndf == NULL) {
+		std::cerr << audioFile << ": error opening audio file: " << sf_strerror(NULL) << std::endl;
+		jobsrun++;
+		failedjobs++;
+		continue;
+	    }
+	    app->sndFileName = audioFile;
+	    app->presetName = presetName;
+	    app->sndFile = sndf;
+	    app->sndInfo = sfinfo;
+	}
 
-    return PROJECTM_SUCCESS;
-#endif
-    // standard main loop
-    int fps = app->settings().fps;
-    printf("fps: %d\n", fps);
-    if (fps <= 0)
-        fps = 60;
-    const Uint32 frame_delay = 1000/fps;
-    struct timespec frstart, frend, frsleep, fract;
-    long long compns = 0;
-    useconds_t prevdly;
-    Uint32 last_time = SDL_GetTicks();
-    app->audioChannelsCount = app->sndInfo.channels;
-    snd_pcm_t *pcm_handle = NULL;
-    snd_pcm_hw_params_t *params;
-    unsigned int tmp;
-    snd_pcm_uframes_t period, bufsz;
-    unsigned int pcm;
-    if (!pcmDevice.empty()) {
-        pcm = snd_pcm_open(&pcm_handle, pcmDevice.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
-        if (pcm < 0) {
-            std::cerr << "cannot open PCM " << snd_strerror(pcm) << std::endl;
-	    exit(EXIT_FAILURE);
-        }
-    }
+	// standard main loop
+	int fps = app->settings().fps;
+	printf("fps: %d\n", fps);
+	if (fps <= 0)
+	    fps = 60;
+	const Uint32 frame_delay = 1000/fps;
+	useconds_t prevdly;
+	Uint32 last_time = SDL_GetTicks();
+	// what projectM sees: anything but stereo is mixed to two channels
+	app->audioChannelsCount = 2;
+	snd_pcm_t *pcm_handle = NULL;
+	snd_pcm_hw_params_t *params;
+	unsigned int tmp;
+	snd_pcm_uframes_t period, bufsz;
+	unsigned int pcm;
+	if (!pcmDevice.empty()) {
+	    pcm = snd_pcm_open(&pcm_handle, pcmDevice.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+	    if (pcm < 0) {
+		std::cerr << "cannot open PCM " << snd_strerror(pcm) << std::endl;
+		exit(EXIT_FAILURE);
+	    }
+	}
 
-    if (pcm_handle != NULL) {
+	if (pcm_handle != NULL) {
 
-        /* Allocate parameters object and fill it with default values*/
-        snd_pcm_hw_params_alloca(&params);
+	    /* Allocate parameters object and fill it with default values*/
+	    snd_pcm_hw_params_alloca(&params);
 
-        snd_pcm_hw_params_any(pcm_handle, params);
+	    snd_pcm_hw_params_any(pcm_handle, params);
 
-        /* Set parameters */
-        if (pcm = snd_pcm_hw_params_set_access(pcm_handle, params,
-             SND_PCM_ACCESS_RW_INTERLEAVED) < 0) 
-             printf("ERROR: Can't set interleaved mode. %s\n", snd_strerror(pcm));
+	    /* Set parameters */
+	    if (pcm = snd_pcm_hw_params_set_access(pcm_handle, params,
+		 SND_PCM_ACCESS_RW_INTERLEAVED) < 0) 
+		 printf("ERROR: Can't set interleaved mode. %s\n", snd_strerror(pcm));
 
-        if (pcm = snd_pcm_hw_params_set_format(pcm_handle, params,
-             SND_PCM_FORMAT_S16_LE) < 0) 
-             printf("ERROR: Can't set format. %s\n", snd_strerror(pcm));
+	    if (pcm = snd_pcm_hw_params_set_format(pcm_handle, params,
+		 floatpcm ? SND_PCM_FORMAT_FLOAT_LE : SND_PCM_FORMAT_S16_LE) < 0) 
+		 printf("ERROR: Can't set format. %s\n", snd_strerror(pcm));
 
-        if (pcm = snd_pcm_hw_params_set_channels(pcm_handle, params, app->sndInfo.channels) < 0) 
-             printf("ERROR: Can't set channels number. %s\n", snd_strerror(pcm));
+	    if (pcm = snd_pcm_hw_params_set_channels(pcm_handle, params, app->sndInfo.channels) < 0) 
+		 printf("ERROR: Can't set channels number. %s\n", snd_strerror(pcm));
 
-        if (pcm = snd_pcm_hw_params_set_rate_near(pcm_handle, params, (unsigned int *)&app->sndInfo.samplerate, 0) < 0) 
-             printf("ERROR: Can't set rate. %s\n", snd_strerror(pcm));
+	    if (pcm = snd_pcm_hw_params_set_rate_near(pcm_handle, params, (unsigned int *)&app->sndInfo.samplerate, 0) < 0) 
+		 printf("ERROR: Can't set rate. %s\n", snd_strerror(pcm));
 
-        std::cout << "set sample rate " << app->sndInfo.samplerate << std::endl;
+	    std::cout << "set sample rate " << app->sndInfo.samplerate << std::endl;
 
-        printf("PCM name: '%s'\n", snd_pcm_name(pcm_handle));
+	    printf("PCM name: '%s'\n", snd_pcm_name(pcm_handle));
 
-        printf("PCM state: %s\n", snd_pcm_state_name(snd_pcm_state(pcm_handle)));
+	    printf("PCM state: %s\n", snd_pcm_state_name(snd_pcm_state(pcm_handle)));
 
-        snd_pcm_hw_params_get_channels(params, &tmp);
-        printf("channels: %i\n", tmp);
+	    snd_pcm_hw_params_get_channels(params, &tmp);
+	    printf("channels: %i\n", tmp);
  
-        snd_pcm_hw_params_get_rate(params, &tmp, 0);
-        printf("rate: %d bps\n", tmp);
+	    snd_pcm_hw_params_get_rate(params, &tmp, 0);
+	    printf("rate: %d bps\n", tmp);
 
 
-     /* Write parameters */
-        if (pcm = snd_pcm_hw_params(pcm_handle, params) < 0)
-            printf("ERROR: Can't set hardware parameters. %s\n", snd_strerror(pcm));
+	 /* Write parameters */
+	    if (pcm = snd_pcm_hw_params(pcm_handle, params) < 0)
+		printf("ERROR: Can't set hardware parameters. %s\n", snd_strerror(pcm));
 
 
-        snd_pcm_hw_params_get_period_size(params, &period, 0);
-        std::cout << "period: " << period << std::endl;
+	    snd_pcm_hw_params_get_period_size(params, &period, 0);
+	    std::cout << "period: " << period << std::endl;
 
 
-        printf("pcm ready\n");
-    }
+	    printf("pcm ready\n");
+	}
 
-    int asamples = app->sndInfo.samplerate / fps;
-    std::cout << "Videoframe: " << frame_delay << " ms.; " << asamples << " audio samples/video frame" << std::endl;
+	int asamples = app->sndInfo.samplerate / fps;
+	std::cout << "Videoframe: " << frame_delay << " ms.; " << asamples << " audio samples/video frame" << std::endl;
 
-    prevdly = asamples;
+	prevdly = asamples;
 
-    int npresets = app->getPlaylistSize();
+	// Decode ahead from here on, so the file is already buffering while
+	// presets load and the -b padding frames render. About two seconds
+	// of blocks. 16 bit PCM WAV and raw files are mapped instead, and
+	// their blocks point straight into the file.
+	pmPCMMap pcmmap;
+	bool mapped = !floatpcm && pcmmap.open(audioFile, app->sndInfo);
+	pmAudioReader audio;
+	if (segment != NULL) {
+	    sf_seek(app->sndFile, (segment->first - segment->preroll) * asamples, SEEK_SET);
+	}
+	audio.start(app->sndFile, app->sndInfo.channels, asamples, 2 * fps, floatpcm, pcm_handle != NULL ? 2 : 1,
+		    mapped ? &pcmmap : NULL);
+	pmPlayback player;
+
+	// one match is locked as before, several leave projectM to rotate;
+	// on the test signal the first match is locked, so runs compare
+	std::vector<int> matches = catalog.find(presetName);
+	double synthlen;
+	bool synthaudio = pmSynthName(audioFile, synthlen);
+	// In a batch the playlist is the whole catalog, so a job whose -p
+	// matches several presets gets a playlist of just those to rotate
+	// through; the next job starts from the whole catalog again.
+	if (jobs.size() > 1) {
+	    bool rotate = matches.size() > 1 && !synthaudio;
+	    if (rotate) {
+		loadPlaylist(app, catalog, matches);
+		for (size_t i = 0; i < matches.size(); i++) matches[i] = i;
+	    } else if (jobnarrowed) {
+		loadPlaylist(app, catalog, std::vector<int>());
+	    }
+	    jobnarrowed = rotate;
+	}
 
-    std::cout << "N presets: " << npresets << std::endl;
+	int npresets = app->getPlaylistSize();
 
-    int sel = -1;
-    for (int i = 0 ; i < npresets ; i++) {
-        if (presetName == app->getPresetName(i)) {
-	   app->selectPreset(i);
-	   app->setPresetLock(1);
-	   sel = i;
-	   break;
-        }
-    }
+	std::cout << "N presets: " << npresets << std::endl;
 
-    if (sel == -1) {
-        std::cerr << "Could not find preset " << presetName << std::endl;
-    }
+	int sel = -1;
+	if (matches.size() == 1 || (synthaudio && !matches.empty())) {
+	    sel = matches[0];
+	    app->selectPreset(sel);
+	    app->setPresetLock(1);
+	} else if (matches.size() > 1) {
+	    sel = matches[rand() % matches.size()];
+	    app->selectPreset(sel);
+	    app->setPresetLock(0);
+	}
 
-    int glbufsz = sizeof( GLubyte ) * ww * wh * 4;
-    int ffmpipe[2] = {-1, -1};
-    GLuint pbo[2];
-    unsigned int frameno = 0;
+	if (sel == -1) {
+	    std::cerr << "Could not find preset " << presetName << std::endl;
+	    app->setPresetLock(0);  // a previous job may have locked one
+	}
 
-    if (!videoName.empty()) {
-        int rc = pipe(ffmpipe);
-	if (rc == -1) {
-	    std::cerr << "ffmpeg video pipe creation error " << strerror(errno) << std::endl;
-	    exit(EXIT_FAILURE);
+	unsigned int frameno = 0;
+	bool exporting = !videoName.empty();
+
+	// One render feeds every -v output; each has its own size, codec,
+	// readback ring and encoder.
+	std::vector<std::unique_ptr<pmRendition>> renditions;
+	if (exporting) {
+	    pmEncodeParams params;
+	    params.encoder = encoder;
+	    params.vcodec = vcodec;
+	    params.gpuPixFmt = gpuPixFmt;
+	    params.outwidth = outwidth;
+	    params.outheight = outheight;
+	    params.encthreads = encthreads;
+	    params.rbdepth = rbdepth;
+	    params.queuelen = queuelen;
+	    params.usesplice = usesplice;
+	    params.fps = fps;
+	    params.samplerate = app->sndInfo.samplerate;
+	    params.channels = app->sndInfo.channels;
+	    params.floatpcm = floatpcm;
+	    params.asamples = asamples;
+	    params.videoonly = segment != NULL;
+	    params.seglen = seglen;
+	    std::vector<pmRenditionSpec> specs;
+	    std::string rendErr;
+	    parseRenditions(videoName, specs, rendErr);    // checked at startup
+	    for (size_t i = 0; i < specs.size(); i++) {
+		renditions.emplace_back(new pmRendition());
+		if (!renditions.back()->open(specs[i], ww, wh, params, rendErr)) {
+		    std::cerr << specs[i].path << ": " << rendErr << std::endl;
+		    jobfailed = true;
+		    break;
+		}
+	    }
+	    ew = renditions[0]->width;
+	    eh = renditions[0]->height;
+	    nrenditions = renditions.size();
 	}
-	int ffmpid = fork();
-	if (ffmpid < 0) {
-	    std::cerr << "ffmpeg process creation error " << strerror(errno) << std::endl;
-	    exit(EXIT_FAILURE);
-	} else if (ffmpid == 0) {
-	    char fmtbuf[50];
-	    snprintf(fmtbuf, 49, "%dx%d", ww, wh);
-	    char fpsbuf[10];
-	    snprintf(fpsbuf, 9, "%d", fps);
-	    char pipebuf[20];
-	    snprintf(pipebuf, 19, "pipe:%d", ffmpipe[0]);
-	    char itsoffset[10];
-	    snprintf(itsoffset, 9, "%ld", before);
-	    const char *ffmargs[] = { "-y", "-video_size", fmtbuf, "-framerate", fpsbuf,
-		                "-f", "rawvideo", "-pix_fmt", "bgra", "-s", fmtbuf,
-				"-i", pipebuf,
-			        "-itsoffset", itsoffset, 
-				"-i", audioFile.c_str(), 
-				"-vcodec", "ffvhuff", "-pix_fmt", "yuv420p", 
-				"-acodec", "aac", "-filter_complex", "[1:0] apad", "-shortest",
-				"-async", "1", "-y", videoName.c_str(), 
-				NULL};
-	    rc = execvp("ffmpeg", (char **)ffmargs);
-	    if (rc < 0) {
- 	        std::cerr << "ffmpeg process exec error " << strerror(errno) << std::endl;
-	        exit(EXIT_FAILURE);
+	if (jobfailed) {
+	    // nothing rendered yet: let go of what the job opened, go on
+	    for (size_t i = 0; i < renditions.size(); i++) renditions[i]->finish();
+	    pmPipeStop(app->sndFile);
+	    audio.stop();
+	    closeAudio(app->sndFile);
+	    if (pcm_handle) snd_pcm_close(pcm_handle);
+	    std::cerr << "Job " << jobno + 1 << "/" << jobs.size() << " (" << audioFile << ") failed" << std::endl;
+	    jobsrun++;
+	    failedjobs++;
+	    continue;
+	}
+
+	// Every video frame carries asamples of audio: the short last block
+	// of the file is padded with silence, so the track stays sample
+	// aligned with the frames and the -a padding that follows.
+	size_t framebytes = (size_t)app->sndInfo.channels * (floatpcm ? sizeof(float) : sizeof(short));
+	std::vector<unsigned char> lastblock(asamples * framebytes);
+	bool warming = false;   // segment pre-roll: render and analyze, export nothing
+	auto sendaudio = [&](const void *pcmdata, int nframes) {
+	    if (!exporting) return;
+	    if (pcmdata != NULL && nframes < asamples) {
+		memcpy(lastblock.data(), pcmdata, nframes * framebytes);
+		memset(lastblock.data() + nframes * framebytes, 0, (asamples - nframes) * framebytes);
+		pcmdata = lastblock.data();
+		nframes = asamples;
+	    }
+	    if (segpcm != NULL && !warming) {
+		const void *data = pcmdata;
+		if (data == NULL) {
+		    memset(lastblock.data(), 0, lastblock.size());
+		    data = lastblock.data();
+		}
+		fwrite(data, framebytes, nframes, segpcm);  // errors checked at the end
+	    }
+	    for (size_t i = 0; i < renditions.size(); i++) {
+		renditions[i]->audio(pcmdata, nframes);
 	    }
+	};
+
+	// With live playback the device position is the master clock: frame
+	// k of the file is due when sample k * asamples is heard. Early frames
+	// sleep until then (the previous frame is held); how late frames are
+	// handled is up to the scheduler's policy. Without a device, live
+	// frames follow the scheduler's own fps grid.
+	pmScheduler sched;
+	sched.start(fps, latepolicy);
+
+	// Only live frames may trade quality for time: an export renders
+	// every frame at full quality however long it takes.
+	pmGovernor governor;
+	bool governing = minscale > 0 && !exporting;
+	if (minscale > 0 && exporting && jobno == 0) {
+	    std::cerr << "-q: quality governor is for live mode only, ignored with -v" << std::endl;
 	}
-        glGenBuffers(2, pbo);
-
-	for (int np = 0; np < 2; np++) {
-	    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[np]);
-            glBufferData(GL_PIXEL_PACK_BUFFER, glbufsz, 0, GL_DYNAMIC_READ);
-            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);	
-	}
-	
-    }
-
-    auto oneframe = [&](SNDFILE *sndf, snd_pcm_t *pcm_hnd) {
-	frameno++;
-	clock_gettime(CLOCK_REALTIME, &frstart);
-        app->renderFrame();
-	if (ffmpipe[1] > -1) {
-    	    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[(frameno - 1) & 1]);
-            glReadPixels(0, 0, ww, wh, GL_BGRA, GL_UNSIGNED_BYTE, 0);
-            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
-	    glFlush(); // its position here is very important
-            GLubyte *ptr = (GLubyte *)glMapNamedBuffer(pbo[frameno & 1], GL_READ_ONLY);
-	    int rc = write(ffmpipe[1], ptr, glbufsz);
-	    glUnmapNamedBuffer(pbo[frameno & 1]);
-	    if (rc < 0) {
-	        std::cerr << "error writing to ffmpeg video pipe " << strerror(errno) << std::endl;
-		close(ffmpipe[1]);
-		ffmpipe[1] = -1;
-		app->done = 1;
-		return;
+	int texsize = app->settings().textureSize;
+	if (governing) {
+	    governor.start(fps, minscale, texsize, texsize / 4 > 256 ? texsize / 4 : 256);
+	}
+	unsigned long long avframe = 0, avheld = 0, avn = 0;
+	double avsum = 0, avmax = 0;
+	auto avsync = [&]() {
+	    double target = (double)avframe++ * asamples, pos;
+	    // the device starts once its buffer is full; don't hang if it never does
+	    for (Uint32 i = 0; !player.position(pos); i++) {
+		if (i >= frame_delay) return sched.wait();
+		usleep(1000);
+	    }
+	    long long aheadns = (target - pos) * 1e9 / app->sndInfo.samplerate;
+	    pmScheduler::Action act = sched.waitUntil(pmScheduler::now() + aheadns);
+	    if (aheadns > 0) {
+		avheld++;
+		player.position(pos);
+	    }
+	    double off = (pos - target) * 1000.0 / app->sndInfo.samplerate;
+	    avsum += off;
+	    if (fabs(off) > avmax) avmax = fabs(off);
+	    avn++;
+	    return act;
+	};
+
+	auto oneframe = [&](SNDFILE *sndf, snd_pcm_t *pcm_hnd) {
+	    PM_TRACE(FRAME);
+	    frameno++;
+	    pmScheduler::Action act = pmScheduler::SHOW;
+	    if (pcm_hnd != NULL && sndf != NULL) {
+		PM_TRACE(PACE);
+		act = avsync();
+	    } else if (!exporting && !warming) {
+		PM_TRACE(PACE);
+		act = sched.wait();
 	    }
-	    fsync(ffmpipe[1]);
-	}
-        unsigned char *samplebuf;
-	sf_count_t nsamples;
-	int smplsize, buflen;
-        if (sndf != NULL) {
-	    smplsize = app->sndInfo.channels * sizeof(short),
-	    buflen = asamples * smplsize;
-	    samplebuf = (unsigned char *)alloca(buflen);
-            nsamples = sf_readf_short(app->sndFile, (short *)samplebuf, asamples);
-	    if (nsamples <= 0) {
-                sf_close(app->sndFile);
-		app->done = 2;
-                return;
+	    if (exporting) act = pmScheduler::SHOW; // every frame goes to the video
+	    unsigned long long workstart = pmTrace::now();
+	    if (act != pmScheduler::SKIP) {
+		app->renderFrame(act == pmScheduler::SHOW);
+		if (exporting && !warming) {
+		    for (size_t i = 0; i < renditions.size(); i++) {
+			if (!renditions[i]->frame()) {
+			    // an encoder failed: stop the job, the others still finish
+			    exporting = false;
+			    jobfailed = true;
+			    app->done = 1;
+			    return;
+			}
+		    }
+		}
+	    }
+	    unsigned char *samplebuf;
+	    int nsamples = 0;
+	    if (sndf != NULL) {
+		// the playback thread reads the same block through its own cursor
+		unsigned long long t0 = pmTrace::now();
+		samplebuf = (unsigned char *)audio.front(nsamples);
+		pmTrace::record(pmTrace::AUDIO, t0, pmTrace::now());
+		if (samplebuf == NULL) {
+		    sendaudio(NULL, asamples);
+		    app->done = 2;
+		    return;
+		} else {
+		    const float *mix = audio.stereo();
+		    PM_TRACE(PCM);
+		    if (mix != NULL) {
+			app->pcm()->addPCMfloat_2ch(mix, nsamples * 2);
+		    } else if (floatpcm) {
+			app->pcm()->addPCMfloat_2ch((float *)samplebuf, nsamples * 2);
+		    } else {
+			app->pcm()->addPCM16Data((short *)samplebuf, nsamples);
+		    }
+		    sendaudio(samplebuf, nsamples);
+		    audio.pop();
+		}
 	    } else {
-	        app->pcm()->addPCM16Data((short *)samplebuf, nsamples);
+		samplebuf = (unsigned char *)alloca(128);
+		app->pcm()->addPCM16Data((short *)samplebuf, 32);
+		sendaudio(NULL, asamples);
 	    }
-	} else {
-	    samplebuf = (unsigned char *)alloca(128);
-	    app->pcm()->addPCM16Data((short *)samplebuf, 32);
-	}
-	unsigned char *aptr;
-	sf_count_t left;
-	if (pcm_hnd != NULL && sndf != NULL) {
-	    snd_pcm_nonblock(pcm_hnd, 0);
-	    for(aptr = samplebuf, left = nsamples; left > 0 ; left -= period, aptr += period * smplsize) {
-	        sf_count_t wrtsize = (left > period)?period:left;
-                if (pcm = snd_pcm_writei(pcm_hnd, aptr, wrtsize) == -EPIPE) {
- 	            snd_pcm_prepare(pcm_hnd);
-                } else if (pcm < 0) {
-                    printf("ERROR. Can't write to PCM device. %s\n", snd_strerror(pcm));
-  	        }
+	    pmGpuTimer::endFrame();
+	    if (governing && act != pmScheduler::SKIP && governor.frame((pmTrace::now() - workstart) / 1e6)) {
+		int oldtex = app->settings().textureSize;
+		app->setRenderScale(governor.scale);
+		if (governor.textureSize != oldtex) {
+		    app->changeTextureSize(governor.textureSize);
+		}
+		std::cout << "Quality level " << governor.level << ": render scale " << governor.scale
+			  << ", texture " << governor.textureSize << " (frame work p90 " << governor.p90
+			  << " ms, budget " << 1000.0 / fps << " ms)" << std::endl;
 	    }
+	    PM_TRACE(EVENTS);
+	    app->pollEvent();
+	};
+
+
+	for(int i = 0; !app->done && i < before * fps ; i++) {
+	    oneframe(NULL, NULL);
+	}
+	if (pcm_handle) {
+	    player.start(pcm_handle, &audio, period,
+			 app->sndInfo.channels * (floatpcm ? sizeof(float) : sizeof(short)),
+			 app->sndInfo.samplerate);
 	}
-        app->pollEvent();
-
-        if (pcm_hnd) {
-	    clock_gettime(CLOCK_REALTIME, &frend);
-	    unsigned long long startns, endns, durns, planns = frame_delay * 1000000ull, actns;
-	    startns = frstart.tv_sec * 1000000000ull + frstart.tv_nsec;
-	    endns = frend.tv_sec * 1000000000ull + frend.tv_nsec;
-	    durns = endns - startns;
-	    if (durns < planns) {
-                frsleep.tv_sec = 0;
-		frsleep.tv_nsec = planns - durns - (compns > 0 ? compns : 0);
-                clock_nanosleep(CLOCK_REALTIME, 0, &frsleep, NULL);
+	if (segment != NULL) {
+	    warming = true;
+	    for (long long i = 0; !app->done && i < segment->preroll; i++) {
+		oneframe(app->sndFile, NULL);
 	    }
-	    clock_gettime(CLOCK_REALTIME, &fract);
-	    actns = fract.tv_sec * 1000000000ull + fract.tv_nsec;
-	    compns = actns - startns - planns;
+	    warming = false;
+	}
+	long long segframes = 0;
+	while (!app->done) {
+	    if (segment != NULL && segment->count >= 0 && segframes++ == segment->count) {
+		app->done = 2;  // end of this segment, same as the end of the file
+		break;
+	    }
+	    oneframe(app->sndFile, pcm_handle);
 	}
-	
-    };
 
+	// Stop decoding first so the playback thread cannot wait on it; it
+	// still gets every block already decoded. At the end of the file let
+	// the device play out, otherwise cut it off. A pipe that has gone
+	// quiet would keep the decoder waiting: end it first.
+	pmPipeStop(app->sndFile);
+	audio.stop();
+	player.stop(app->done != 2);
+	closeAudio(app->sndFile);
+	if (pcm_handle) snd_pcm_close(pcm_handle);
+	pcm_handle = NULL;
+	// a failed job stopped itself; only a closed window ends the batch
+	app->done = app->done == 1 && !jobfailed ? 1 : 0;
 
-    for(int i = 0; !app->done && i < before * fps ; i++) {
-	oneframe(NULL, NULL);
+	for(int i = 0; !app->done && !jobfailed && i < after * fps ; i++) {
+	    oneframe(NULL, NULL);
+	}
+
+	for (size_t i = 0; i < renditions.size(); i++) {
+	    if (!renditions[i]->finish()) jobfailed = true;
+	    exportbytes += renditions[i]->bytes;
+	}
+	if (segpcm != NULL) {
+	    if (ferror(segpcm) | (fclose(segpcm) != 0)) {
+		std::cerr << "cannot write " << segment->pcmpath << std::endl;
+		jobfailed = true;
+	    }
+	    segpcm = NULL;
+	}
+	audio.report(std::cout);
+	double cpuuser, cpusys;
+	cpuTime(cpuuser, cpusys);
+	std::cout << "CPU: user " << cpuuser - jobuser << " s, system " << cpusys - jobsys << " s ("
+		  << (cpuuser - jobuser + cpusys - jobsys) * 1e9 / (pmScheduler::now() - jobstart) * 100
+		  << "% of one core)" << std::endl;
+	if (avframe > 0) {
+	    player.report(std::cout);
+	    std::cout << "A/V offset: mean " << (avn > 0 ? avsum / avn : 0) << " ms, max " << avmax
+		      << " ms over " << avn << " frames; " << avheld << " held for the audio clock" << std::endl;
+	}
+	sched.report(std::cout);
+	governor.report(std::cout);
+	if (governing && governor.level > 0) {
+	    // the next job starts at full quality again
+	    app->setRenderScale(1.0f);
+	    app->changeTextureSize(texsize);
+	}
+
+	for (size_t i = 0; i < renditions.size(); i++) {
+	    renditions[i]->report(std::cout);
+	}
+
+	double job_s = (pmScheduler::now() - jobstart) / 1e9;
+	// a stream's length is only known once it has been read
+	double audio_s = app->sndInfo.frames == SF_COUNT_MAX ? (double)frameno / fps
+	                                                    : (double)app->sndInfo.frames / app->sndInfo.samplerate;
+	batchframes += frameno;
+	jobsrun++;
+	if (jobfailed) {
+	    failedjobs++;
+	    std::cerr << "Job " << jobno + 1 << "/" << jobs.size() << " (" << audioFile << ") failed" << std::endl;
+	}
+	if (jobs.size() > 1) {
+	    std::cout << "Job " << jobno + 1 << "/" << jobs.size() << " (" << audioFile << "): "
+	              << frameno << " frames in " << job_s << " s, " << frameno / job_s << " fps, "
+	              << audio_s / job_s << "x realtime" << (jobfailed ? ", FAILED" : "") << std::endl;
+	}
+	if (app->done) break;   // window closed: drop the rest of the batch
     }
-    while (!app->done) {
-        oneframe(app->sndFile, pcm_handle);
+    if (jobs.size() > 1) {
+	double batch_s = (pmScheduler::now() - batchstart) / 1e9;
+	std::cout << "Batch: " << jobsrun << "/" << jobs.size() << " jobs run, " << failedjobs << " failed, "
+	          << batchframes << " frames in "
+	          << batch_s << " s, " << batchframes / batch_s << " fps" << std::endl;
     }
-
-    if (app->done == 2) {
-	app->done = 0;
-        if (pcm_handle) snd_pcm_close(pcm_handle);
-	pcm_handle = NULL;
+    if (!benchJson.empty()) {
+	pmRunStats run;
+	run.audio = manifest.empty() ? audioFile : manifest;
+	run.preset = presetName;
+	run.encoder = videoName.empty() ? "none" : encoder + "/" + vcodec;
+	if (nrenditions > 1) run.encoder += " x" + std::to_string(nrenditions);
+	run.width = ww;
+	run.height = wh;
+	run.outwidth = ew;
+	run.outheight = eh;
+	run.frames = batchframes;
+	run.bytes = exportbytes;
+	run.seconds = (pmScheduler::now() - batchstart) / 1e9;
+	cpuTime(run.cpuuser, run.cpusys);
+	std::string benchErr;
+	if (!pmBench::appendRun(benchJson, run, benchErr)) {
+	    std::cerr << benchErr << std::endl;
+	}
     }
 
-    for(int i = 0; !app->done && i < after * fps ; i++) {
-	oneframe(NULL, NULL);
+    pmShaderCache::report(std::cout);
+    pmGpuTimer::destroy();
+    pmTrace::report(std::cout);
+    if (!traceFile.empty()) {
+	std::string traceErr;
+	if (pmTrace::writeChrome(traceFile, traceErr)) {
+	    std::cout << "Trace written to " << traceFile << std::endl;
+	} else {
+	    std::cerr << traceErr << std::endl;
+	}
     }
 
-    close(ffmpipe[1]);
-
-    SDL_GL_DeleteContext(glCtx);
-
     delete app;
 
-    return PROJECTM_SUCCESS;
+    if (win != NULL) {
+        SDL_GL_DeleteContext(glCtx);
+    } else {
+        egl.destroy();
+    }
+
+    // failed or dropped jobs fail the run; a -j worker's status is what
+    // tells the parent its segment is usable
+    return failedjobs == 0 && jobsrun == jobs.size() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 
@@ -0,0 +1,95 @@
+/**
+* projectM -- Milkdrop-esque visualisation SDK
+* Copyright (C)2003-2019 projectM Team
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+* See 'LICENSE.txt' included within this release
+*
+* projectM-sndf
+* This is an implementation of projectM using libSDL2 and reading audio from a file
+*
+* pmBatchTest.cpp
+* Job manifest parser checks (make test).
+*
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+
+#include "../pmBatch.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static bool parse(const std::string &text, std::vector<pmJob> &jobs, std::string &err) {
+    char path[] = "/tmp/pmBatchTestXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    std::ofstream(path) << text;
+    jobs.clear();
+    err.clear();
+    bool ok = readManifest(path, jobs, err);
+    unlink(path);
+    return ok;
+}
+
+int main() {
+    std::vector<pmJob> jobs;
+    std::string err;
+
+    // every field, comments and blank lines skipped, CRLF tolerated
+    CHECK(parse("# set\n\na.wav\tGeiss - Cosmic\ta.mkv\t2\t3\r\n", jobs, err));
+    CHECK(jobs.size() == 1);
+    if (jobs.size() == 1) {
+        CHECK(jobs[0].audioFile == "a.wav");
+        CHECK(jobs[0].presetName == "Geiss - Cosmic");
+        CHECK(jobs[0].videoName == "a.mkv");
+        CHECK(jobs[0].before == 2 && jobs[0].after == 3);
+    }
+
+    // an empty output column: play or show without exporting
+    CHECK(parse("a.wav\tGeiss\t\n", jobs, err));
+    CHECK(jobs.size() == 1 && jobs[0].videoName.empty());
+
+    // empty preset and output, padding given
+    CHECK(parse("a.wav\t\t\t1\n", jobs, err));
+    CHECK(jobs.size() == 1 && jobs[0].presetName.empty() && jobs[0].videoName.empty() && jobs[0].before == 1);
+
+    // malformed lines
+    CHECK(!parse("a.wav\tGeiss\n", jobs, err) && !err.empty());
+    CHECK(!parse("\tGeiss\ta.mkv\n", jobs, err));
+    CHECK(!parse("a.wav\tGeiss\ta.mkv\tsoon\n", jobs, err));
+    CHECK(!parse("a.wav\tGeiss\ta.mkv\t1\t2\t3\n", jobs, err));
+    CHECK(!parse("# nothing\n", jobs, err));
+
+    if (failures > 0) {
+        fprintf(stderr, "pmBatchTest: %d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("pmBatchTest: ok\n");
+    return EXIT_SUCCESS;
+}